@@ -0,0 +1,123 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Times the builtin BC1, BC3, BC4 and BC5 encoder with each instruction set the CPU supports
+
+#include "btu/tex/detail/compress_bcn.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using btu::tex::EncodingQuality;
+using btu::tex::detail::BcFormat;
+using btu::tex::detail::InstructionSet;
+
+constexpr uint32_t k_size      = 2048;
+constexpr int k_runs           = 5;
+constexpr size_t k_channels    = 4;
+constexpr size_t k_pixel_count = size_t{k_size} * k_size;
+
+/// Smooth gradients are the common case, noise is the worst one for endpoint fitting
+auto generate(bool noise) -> std::vector<uint8_t>
+{
+    auto pixels = std::vector<uint8_t>(k_pixel_count * k_channels);
+    auto rng    = std::mt19937{42}; // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    for (size_t y = 0; y < k_size; ++y)
+    {
+        for (size_t x = 0; x < k_size; ++x)
+        {
+            const auto value = [&](size_t smooth) { return static_cast<uint8_t>(noise ? rng() : smooth); };
+            const auto pixel = std::span(pixels).subspan((y * k_size + x) * k_channels, k_channels);
+            pixel[0]         = value(x * 255 / k_size);
+            pixel[1]         = value(y * 255 / k_size);
+            pixel[2]         = value((x + y) * 127 / k_size);
+            pixel[3]         = value(255 - x * 255 / k_size);
+        }
+    }
+    return pixels;
+}
+
+/// \return The average time of an encode, in milliseconds
+auto time_encode(const std::vector<uint8_t> &pixels,
+                 BcFormat format,
+                 EncodingQuality quality,
+                 InstructionSet isa) -> double
+{
+    // BC3 and BC5 take a byte per pixel, BC1 and BC4 half of it
+    auto blocks      = std::vector<uint8_t>(k_pixel_count);
+    const auto image = btu::tex::detail::BlockImage{
+        .pixels    = pixels.data(),
+        .row_pitch = size_t{k_size} * k_channels,
+        .width     = k_size,
+        .height    = k_size,
+        .blocks    = blocks.data(),
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < k_runs; ++run)
+    {
+        if (!btu::tex::detail::convert_bcn(std::span(&image, 1), format, quality, {}, isa))
+        {
+            std::cerr << "Encoding failed\n";
+            return 0.;
+        }
+    }
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / k_runs;
+}
+
+auto main() -> int
+{
+    constexpr auto formats = std::to_array<std::pair<BcFormat, std::string_view>>({
+        {BcFormat::Bc1, "BC1"},
+        {BcFormat::Bc3, "BC3"},
+        {BcFormat::Bc4, "BC4"},
+        {BcFormat::Bc5, "BC5"},
+    });
+
+    constexpr auto qualities = std::to_array<std::pair<EncodingQuality, std::string_view>>({
+        {EncodingQuality::Fast, "fast"},
+        {EncodingQuality::Normal, "normal"},
+        {EncodingQuality::Max, "max"},
+    });
+
+    constexpr auto isas = std::to_array<std::pair<InstructionSet, std::string_view>>({
+        {InstructionSet::Scalar, "scalar"},
+        {InstructionSet::Sse41, "sse4.1"},
+        {InstructionSet::Avx2, "avx2"},
+    });
+
+    std::cout << "Encoding " << k_size << 'x' << k_size << " textures, average of " << k_runs << " runs\n";
+    for (const bool noise : {false, true})
+    {
+        const auto pixels = generate(noise);
+        std::cout << '\n' << (noise ? "Noise" : "Gradient") << '\n';
+        for (const auto &[format, format_name] : formats)
+        {
+            for (const auto &[quality, quality_name] : qualities)
+            {
+                std::cout << format_name << ' ' << std::setw(6) << quality_name << ':';
+                for (const auto &[isa, isa_name] : isas)
+                {
+                    // Kernels the CPU does not support would fall back to the best one
+                    if (isa > btu::tex::detail::best_instruction_set())
+                        break;
+                    std::cout << "  " << isa_name << ' ' << std::fixed << std::setprecision(1)
+                              << time_encode(pixels, format, quality, isa) << " ms";
+                }
+                std::cout << '\n';
+            }
+        }
+    }
+    return 0;
+}
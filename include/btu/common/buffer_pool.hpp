@@ -0,0 +1,150 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace btu::common {
+/**
+ * \brief Keeps the buffers released on a thread, to hand them out again instead of allocating and faulting in
+ * fresh memory for every file of a batch.
+ *
+ * Each thread has its own pool, so no locking is needed. A buffer destroyed on another thread than the one
+ * that acquired it is freed instead of being given back, as the pool belongs to the acquiring thread.
+ */
+template<class T>
+class BufferPool
+{
+public:
+    /// Buffers kept by a pool
+    static constexpr size_t k_max_buffers = 16;
+    /// Memory kept by a pool. Larger buffers are freed when released.
+    static constexpr size_t k_max_bytes = size_t{256} * 1024 * 1024;
+
+    /// A buffer borrowed from a pool, given back when destroyed
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(const Buffer &) = delete;
+        Buffer(Buffer &&other) noexcept
+            : pool_(std::exchange(other.pool_, nullptr))
+            , owner_(other.owner_)
+            , data_(std::move(other.data_))
+        {
+        }
+        auto operator=(const Buffer &) -> Buffer & = delete;
+        auto operator=(Buffer &&other) noexcept -> Buffer &
+        {
+            std::swap(pool_, other.pool_);
+            std::swap(owner_, other.owner_);
+            std::swap(data_, other.data_);
+            return *this;
+        }
+        ~Buffer()
+        {
+            if (pool_ != nullptr && owner_ == std::this_thread::get_id())
+                pool_->release(std::move(data_));
+        }
+
+        [[nodiscard]] auto data() noexcept -> T * { return data_.data(); }
+        [[nodiscard]] auto data() const noexcept -> const T * { return data_.data(); }
+        [[nodiscard]] auto size() const noexcept -> size_t { return data_.size(); }
+
+        [[nodiscard]] auto begin() noexcept { return data_.begin(); }
+        [[nodiscard]] auto begin() const noexcept { return data_.begin(); }
+        [[nodiscard]] auto end() noexcept { return data_.end(); }
+        [[nodiscard]] auto end() const noexcept { return data_.end(); }
+
+        [[nodiscard]] auto operator[](size_t i) noexcept -> T & { return data_[i]; }
+        [[nodiscard]] auto operator[](size_t i) const noexcept -> const T & { return data_[i]; }
+
+    private:
+        friend class BufferPool;
+
+        Buffer(BufferPool *pool, std::vector<T> data) noexcept
+            : pool_(pool)
+            , owner_(std::this_thread::get_id())
+            , data_(std::move(data))
+        {
+        }
+
+        BufferPool *pool_ = nullptr;
+        /// Thread that acquired the buffer, the only one allowed to give it back
+        std::thread::id owner_;
+        std::vector<T> data_;
+    };
+
+    BufferPool() { free_.reserve(k_max_buffers + 1); }
+
+    /// The pool of the calling thread
+    [[nodiscard]] static auto local() noexcept -> BufferPool &
+    {
+        thread_local auto pool = BufferPool{};
+        return pool;
+    }
+
+    /// \return A buffer of `size` elements. Elements of a reused buffer keep their previous value.
+    [[nodiscard]] auto acquire(size_t size) -> Buffer
+    {
+        // The smallest buffer that is large enough, so that larger ones stay available for larger requests
+        auto best = free_.end();
+        for (auto it = free_.begin(); it != free_.end(); ++it)
+        {
+            if (it->capacity() >= size && (best == free_.end() || it->capacity() < best->capacity()))
+                best = it;
+        }
+
+        auto data = std::vector<T>{};
+        if (best != free_.end())
+        {
+            data = std::move(*best);
+            free_.erase(best);
+            bytes_ -= data.capacity() * sizeof(T);
+        }
+        data.resize(size);
+        return Buffer(this, std::move(data));
+    }
+
+    /// Memory kept by the pool, in bytes
+    [[nodiscard]] auto pooled_bytes() const noexcept -> size_t { return bytes_; }
+
+    /// Frees the buffers kept by the pool
+    void clear() noexcept
+    {
+        free_.clear();
+        bytes_ = 0;
+    }
+
+private:
+    void release(std::vector<T> &&data) noexcept
+    {
+        const auto bytes = data.capacity() * sizeof(T);
+        if (bytes == 0 || bytes > k_max_bytes)
+            return;
+
+        free_.push_back(std::move(data));
+        bytes_ += bytes;
+
+        // Small buffers are the cheapest to allocate again
+        while (free_.size() > k_max_buffers || bytes_ > k_max_bytes)
+        {
+            const auto smallest = std::ranges::min_element(free_, {}, [](const auto &buf) {
+                return buf.capacity();
+            });
+            bytes_ -= smallest->capacity() * sizeof(T);
+            free_.erase(smallest);
+        }
+    }
+
+    std::vector<std::vector<T>> free_;
+    size_t bytes_ = 0;
+};
+} // namespace btu::common
@@ -7,17 +7,49 @@
 
 #include <btu/common/error.hpp>
 #include <btu/common/path.hpp>
+#include <mpsc/mpsc_channel.hpp>
 #include <tl/expected.hpp>
 
 #include <span>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 namespace btu::common {
+using PathReceiver = std::tuple_element_t<1, decltype(mpsc::Channel<Path>::make())>;
+
 [[nodiscard]] auto read_file(const Path &a_path) noexcept -> tl::expected<std::vector<std::byte>, Error>;
 
 [[nodiscard]] auto write_file(const Path &a_path,
                               std::span<const std::byte> data) noexcept -> tl::expected<void, Error>;
 
+/// Read-only memory mapping of a whole file. Pages are only read from disk when accessed.
+class MappedFile
+{
+public:
+    [[nodiscard]] static auto open(const Path &path) noexcept -> tl::expected<MappedFile, Error>;
+
+    MappedFile(const MappedFile &)                     = delete;
+    auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    auto operator=(MappedFile &&other) noexcept -> MappedFile &;
+
+    ~MappedFile();
+
+    [[nodiscard]] auto data() const noexcept -> std::span<const std::byte> { return {data_, size_}; }
+
+private:
+    MappedFile() = default;
+    void close() noexcept;
+
+    const std::byte *data_ = nullptr;
+    size_t size_           = 0;
+#ifdef _WIN32
+    void *mapping_ = nullptr;
+#endif
+};
+
 [[nodiscard]] auto write_file_new(const Path &a_path,
                                   std::span<const std::byte> data) noexcept -> tl::expected<void, Error>;
 
@@ -27,6 +59,19 @@ namespace btu::common {
 
 [[nodiscard]] auto hard_link(const Path &from, const Path &to) noexcept -> tl::expected<void, Error>;
 
+/**
+ * \brief Lists the regular files under `dir`, recursively, exploring subdirectories in parallel.
+ *
+ * Paths are sent to the receiver as soon as they are found, in no particular order, so that processing can
+ * start before the walk is over. The channel is closed once the walk is over. Requesting a stop on the
+ * returned thread ends the walk early. Directories that cannot be read are skipped, and symbolic links to
+ * directories are not followed, like `fs::recursive_directory_iterator`.
+ */
+[[nodiscard]] auto walk_files_mt(Path dir) noexcept -> std::pair<std::jthread, PathReceiver>;
+
+/// Same as `walk_files_mt`, but waits for the walk to be over.
+[[nodiscard]] auto list_files_mt(const Path &dir) noexcept -> std::vector<Path>;
+
 [[nodiscard]] auto find_matching_paths_icase(const btu::Path &directory,
                                              std::span<const btu::Path> relative_lowercase_paths) noexcept
     -> std::vector<btu::Path>;
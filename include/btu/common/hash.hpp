@@ -0,0 +1,78 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace btu::common {
+/**
+ * \brief Streaming 64 bits FNV-1a hasher.
+ *
+ * Not cryptographic, but stable across platforms and runs, so it can be stored on disk.
+ */
+class Hasher
+{
+public:
+    constexpr auto update(std::span<const std::byte> data) noexcept -> Hasher &
+    {
+        for (const auto b : data)
+        {
+            state_ ^= static_cast<std::uint64_t>(b);
+            state_ *= k_prime;
+        }
+        return *this;
+    }
+
+    template<typename Char>
+    constexpr auto update(std::basic_string_view<Char> str) noexcept -> Hasher &
+        requires(sizeof(Char) == 1)
+    {
+        for (const auto c : str)
+        {
+            state_ ^= static_cast<std::uint64_t>(static_cast<unsigned char>(c));
+            state_ *= k_prime;
+        }
+        return *this;
+    }
+
+    /// Hashes the value as little endian bytes, so that the result does not depend on the platform.
+    template<typename Int>
+        requires std::is_integral_v<Int> || std::is_enum_v<Int>
+    constexpr auto update(Int value) noexcept -> Hasher &
+    {
+        auto bits = static_cast<std::uint64_t>(value);
+        for (size_t i = 0; i < sizeof(Int); ++i)
+        {
+            state_ ^= bits & 0xFFU;
+            state_ *= k_prime;
+            bits >>= 8U;
+        }
+        return *this;
+    }
+
+    [[nodiscard]] constexpr auto digest() const noexcept -> std::uint64_t { return state_; }
+
+private:
+    static constexpr std::uint64_t k_offset_basis = 0xcbf2'9ce4'8422'2325;
+    static constexpr std::uint64_t k_prime        = 0x0000'0100'0000'01b3;
+
+    std::uint64_t state_ = k_offset_basis;
+};
+
+[[nodiscard]] constexpr auto hash(std::span<const std::byte> data) noexcept -> std::uint64_t
+{
+    return Hasher{}.update(data).digest();
+}
+
+[[nodiscard]] constexpr auto hash(std::string_view str) noexcept -> std::uint64_t
+{
+    return Hasher{}.update(str).digest();
+}
+} // namespace btu::common
@@ -4,6 +4,10 @@
 #include <btu/common/functional.hpp>
 #include <btu/common/metaprogramming.hpp>
 
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
 #include <span>
 
 namespace btu::common {
@@ -129,6 +133,85 @@ public:
     return ThreadPool{num_threads};
 }
 
+/**
+ * \brief Byte budget shared by concurrent jobs, to admit work only while the memory it needs is available.
+ *
+ * A job reserves its estimated peak memory before starting and releases it when done. A job larger than the
+ * whole budget is still admitted when nothing else is running, so it is delayed instead of being starved.
+ */
+class MemoryBudget
+{
+public:
+    static constexpr auto k_unlimited = std::numeric_limits<std::uint64_t>::max();
+
+    explicit MemoryBudget(std::uint64_t limit = k_unlimited) noexcept
+        : limit_(limit)
+    {
+    }
+
+    MemoryBudget(const MemoryBudget &)                     = delete;
+    auto operator=(const MemoryBudget &) -> MemoryBudget & = delete;
+
+    /// Blocks until `bytes` can be reserved.
+    void acquire(std::uint64_t bytes) noexcept
+    {
+        auto lock = std::unique_lock{mutex_};
+        cv_.wait(lock, [&] { return fits(bytes); });
+        used_ += bytes;
+    }
+
+    /// Reserves `bytes` if it fits in the remaining budget. Never blocks.
+    [[nodiscard]] auto try_acquire(std::uint64_t bytes) noexcept -> bool
+    {
+        const auto lock = std::lock_guard{mutex_};
+        if (!fits(bytes))
+            return false;
+        used_ += bytes;
+        return true;
+    }
+
+    void release(std::uint64_t bytes) noexcept
+    {
+        {
+            const auto lock = std::lock_guard{mutex_};
+            used_ -= std::min(bytes, used_);
+        }
+        cv_.notify_all();
+    }
+
+    void set_limit(std::uint64_t limit) noexcept
+    {
+        {
+            const auto lock = std::lock_guard{mutex_};
+            limit_          = limit;
+        }
+        cv_.notify_all();
+    }
+
+    [[nodiscard]] auto limit() const noexcept -> std::uint64_t
+    {
+        const auto lock = std::lock_guard{mutex_};
+        return limit_;
+    }
+
+    [[nodiscard]] auto used() const noexcept -> std::uint64_t
+    {
+        const auto lock = std::lock_guard{mutex_};
+        return used_;
+    }
+
+private:
+    [[nodiscard]] auto fits(std::uint64_t bytes) const noexcept -> bool
+    {
+        return used_ == 0 || bytes <= limit_ - std::min(used_, limit_);
+    }
+
+    std::uint64_t limit_;
+    std::uint64_t used_ = 0;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
 template<typename Range, typename Func>
     requires std::ranges::input_range<Range> && invocable_l_or_r<Func, std::ranges::range_value_t<Range>>
 auto for_each_mt(Range &&rng, Func &&func)
@@ -0,0 +1,63 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <btu/common/error.hpp>
+#include <btu/common/path.hpp>
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace btu::modmanager {
+/// Files with the same content
+struct DuplicateGroup
+{
+    std::uint64_t size{};
+    /// Sorted. The first file is the one kept by `hard_link_duplicates`.
+    std::vector<Path> files;
+
+    /// Disk space used by all the copies but one
+    [[nodiscard]] auto wasted_bytes() const noexcept -> std::uint64_t { return size * (files.size() - 1); }
+
+    [[nodiscard]] auto operator==(const DuplicateGroup &) const noexcept -> bool = default;
+};
+
+/// Hashing the start of a file is enough to tell most files of the same size apart
+constexpr std::uint64_t k_partial_hash_size = 16 * 1024;
+
+/**
+ * \brief Finds the files with the same content under `dirs`, e.g. all the mods of a MO2 install.
+ *
+ * Files are first grouped by size, then by a hash of their first `k_partial_hash_size` bytes, and only the
+ * remaining candidates are fully hashed. Hashing is done in parallel.
+ * Archives are compared as a whole, their content is not read.
+ * \param min_size Smaller files are ignored. Empty files are always ignored.
+ * \return The groups, sorted by decreasing wasted space
+ */
+[[nodiscard]] auto find_duplicates(std::span<const Path> dirs,
+                                   std::uint64_t min_size = 1) noexcept -> std::vector<DuplicateGroup>;
+
+struct DeduplicationReport
+{
+    size_t linked_files{};
+    std::uint64_t saved_bytes{};
+    /// Files that could not be replaced. They are left untouched.
+    std::vector<std::pair<Path, common::Error>> failures;
+};
+
+/**
+ * \brief Replaces every file of each group but the first one with a hard link to the first one.
+ *
+ * Files are compared byte by byte before being replaced, so files changed since `find_duplicates` are left
+ * untouched. Each file is replaced atomically. Files that are already linked together are skipped.
+ * \note Linked files share their content: writing to one of them in place, as `ModFolder::transform` does,
+ * changes all of them.
+ */
+[[nodiscard]] auto hard_link_duplicates(std::span<const DuplicateGroup> groups) noexcept
+    -> DeduplicationReport;
+} // namespace btu::modmanager
@@ -0,0 +1,96 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <btu/common/error.hpp>
+#include <btu/common/path.hpp>
+#include <btu/common/threading.hpp>
+#include <tl/expected.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace btu::modmanager {
+/// State of a file on disk, as recorded after it was last processed.
+struct FileState
+{
+    std::uint64_t size{};
+    std::int64_t mtime{};
+    std::uint64_t content_hash{};
+    std::uint64_t settings_hash{};
+
+    [[nodiscard]] auto operator==(const FileState &) const noexcept -> bool = default;
+};
+
+/// State of a file stored in an archive. Archive entries have no meaningful modification time.
+struct ArchiveEntryState
+{
+    std::uint64_t size{};
+    std::uint64_t content_hash{};
+    std::uint64_t settings_hash{};
+
+    [[nodiscard]] auto operator==(const ArchiveEntryState &) const noexcept -> bool = default;
+};
+
+/**
+ * \brief Persistent record of the files processed in a mod folder, used to skip unchanged files.
+ *
+ * Paths are relative to the mod folder. Archive entries are keyed by the relative path of their archive,
+ * then by their path inside the archive.
+ * The manifest is only a cache: a missing or corrupted file results in an empty manifest.
+ * \note Thread-safe.
+ */
+class Manifest
+{
+public:
+    /// Loads the manifest at `path`, or starts an empty one if it cannot be read.
+    explicit Manifest(Path path) noexcept;
+
+    /// Writes the manifest to disk. The previous file is replaced atomically.
+    [[nodiscard]] auto save() const noexcept -> tl::expected<void, common::Error>;
+    /// Whether the manifest was modified since it was last saved or loaded
+    [[nodiscard]] auto dirty() const noexcept -> bool { return dirty_; }
+
+    [[nodiscard]] auto file(const Path &relative_path) const noexcept -> std::optional<FileState>;
+    void set_file(const Path &relative_path, FileState state) noexcept;
+    void remove_file(const Path &relative_path) noexcept;
+
+    [[nodiscard]] auto archive_entry(const Path &archive_relative_path, const Path &entry_path) const noexcept
+        -> std::optional<ArchiveEntryState>;
+    /// Records an archive and replaces all its entries. Entries absent from `entries` are forgotten.
+    void set_archive(const Path &archive_relative_path,
+                     FileState state,
+                     std::span<const std::pair<Path, ArchiveEntryState>> entries) noexcept;
+
+    [[nodiscard]] auto path() const noexcept -> const Path & { return path_; }
+    /// File written by `save` before it replaces the manifest
+    [[nodiscard]] auto temporary_path() const -> Path;
+
+    /// Reads the size and modification time of a file. The hashes are left empty.
+    [[nodiscard]] static auto stat(const Path &absolute_path) noexcept -> std::optional<FileState>;
+
+private:
+    using ArchiveEntries = std::unordered_map<std::u8string, ArchiveEntryState>;
+
+    struct Data
+    {
+        std::unordered_map<std::u8string, FileState> files;
+        std::unordered_map<std::u8string, ArchiveEntries> archives;
+    };
+
+    Path path_;
+    common::synchronized<Data> data_;
+    /// Saves write to the same temporary file
+    mutable std::mutex save_mutex_;
+    mutable std::atomic_bool dirty_ = false;
+};
+} // namespace btu::modmanager
@@ -0,0 +1,73 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <btu/common/threading.hpp>
+#include <btu/modmanager/mod_folder.hpp>
+#include <btu/modmanager/mod_manager.hpp>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace btu::modmanager {
+/**
+ * \brief Processes many mod folders with a single thread pool and memory budget.
+ *
+ * Several mods are in flight at once, so that the pool is fed with the files of the next mod while the last
+ * files of the previous one are still running. Each mod has its own transformer, so progress, cancellation
+ * and errors are still reported per mod.
+ */
+class ModBatch
+{
+public:
+    /// Creates the transformer of a mod. It is destroyed once the mod is done.
+    using TransformerFactory = std::function<std::unique_ptr<ModFolderTransformer>(ModFolder &mod)>;
+    /// Called once a mod is done, from the thread that processed it
+    using ModDone = std::function<void(ModFolder &mod, ModFolderTransformer &transformer)>;
+
+    static constexpr size_t k_default_concurrent_mods = 2;
+
+    explicit ModBatch(bsa::Settings bsa_settings, bool ignore_existing_archives = false);
+
+    /**
+     * \brief Adds the mods of `dir`, depending on the mod manager found by `find_manager`.
+     *
+     * With MO2 and Vortex, or when forced, every subdirectory is a mod. MO2 separators are skipped.
+     * Otherwise, `dir` itself is the only mod.
+     * \return The detected mod manager
+     */
+    auto add_mods_directory(const Path &dir) -> ModManager;
+
+    auto add_mod(Path dir) -> ModFolder &;
+
+    /// The mods, in the order they will be processed. They can be configured before processing,
+    /// e.g. with `ModFolder::use_manifest`.
+    [[nodiscard]] auto mods() noexcept -> std::deque<ModFolder> & { return mods_; }
+
+    void transform(const TransformerFactory &make_transformer, const ModDone &on_mod_done = {}) noexcept;
+
+    /// Number of mods processed at the same time. More mods keep the pool busier, but need more memory.
+    void set_concurrent_mods(size_t count) noexcept { concurrent_mods_ = std::max<size_t>(count, 1); }
+    /// Limit the memory used by the jobs of all mods, in bytes. \see ModFolder::set_memory_budget
+    void set_memory_budget(std::uint64_t bytes) noexcept { memory_budget_.set_limit(bytes); }
+
+    /// Stops starting new mods. Mods already started are stopped by their own transformer.
+    void request_stop() noexcept { stop_requested_ = true; }
+
+private:
+    bsa::Settings bsa_settings_;
+    bool ignore_existing_archives_;
+    size_t concurrent_mods_          = k_default_concurrent_mods;
+    std::atomic_bool stop_requested_ = false;
+    common::MemoryBudget memory_budget_;
+    common::ThreadPool thread_pool_;
+    /// Drives the archives of every mod. \see ModFolder::use_archive_thread_pool
+    common::ThreadPool archive_thread_pool_;
+    std::deque<ModFolder> mods_;
+};
+} // namespace btu::modmanager
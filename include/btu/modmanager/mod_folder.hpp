@@ -8,17 +8,92 @@
 #include <btu/bsa/archive.hpp>
 #include <btu/bsa/settings.hpp>
 #include <btu/common/error.hpp>
+#include <btu/common/filesystem.hpp>
 #include <btu/common/functional.hpp>
 #include <btu/common/path.hpp>
 #include <btu/common/threading.hpp>
+#include <btu/modmanager/manifest.hpp>
+#include <btu/modmanager/transform_cache.hpp>
 #include <tl/expected.hpp>
 
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
 namespace btu::modmanager {
+/**
+ * \brief Content of a file, loaded on first access.
+ *
+ * `view` gives read-only access without any copy: loose files are memory mapped, so reading a header only
+ * touches a few pages, and files from archives are viewed in their decompressed buffer.
+ * `operator*` gives an owned buffer, for transformers that build their output from the input.
+ */
+class FileContent
+{
+public:
+    using Bytes  = std::vector<std::byte>;
+    using Result = tl::expected<Bytes, common::Error>;
+    using View   = tl::expected<std::span<const std::byte>, common::Error>;
+
+    /// Content produced on demand, e.g. by decompressing a file from an archive.
+    explicit FileContent(std::function<Result()> load) noexcept;
+
+    /// Content of a file on disk. It is memory mapped when viewed, and only read when an owned buffer is
+    /// needed.
+    [[nodiscard]] static auto from_file(Path absolute_path) noexcept -> FileContent;
+
+    /// Content already in memory.
+    [[nodiscard]] static auto from_bytes(Bytes bytes) noexcept -> FileContent;
+
+    /// Content viewing this one, so that it can be handed to another consumer without copying it.
+    /// It is only copied if the consumer asks for an owned buffer. This object must outlive the returned one.
+    [[nodiscard]] auto borrow() const noexcept -> FileContent;
+
+    /// Read-only view of the content. It is valid as long as this object is alive and the buffer returned by
+    /// `operator*` is neither modified nor moved from.
+    [[nodiscard]] auto view() const noexcept -> View;
+
+    /// Owned content. For a loose file that was already viewed, it is copied from the mapping.
+    auto operator*() const noexcept -> Result &;
+    auto operator->() const noexcept -> Result * { return &**this; }
+
+private:
+    using Mapping = tl::expected<std::shared_ptr<const common::MappedFile>, common::Error>;
+
+    std::function<Result()> load_;
+    /// Empty if the content does not come from a loose file
+    Path path_;
+    /// Null if the content is not borrowed
+    const FileContent *borrowed_ = nullptr;
+    mutable std::optional<Mapping> mapping_;
+    mutable std::optional<Result> owned_;
+};
+
+/// Scratch state of a worker thread, such as buffers or encoders, reused for all the files it processes.
+/// \see ModFolderTransformer::make_worker_context
+class WorkerContext
+{
+public:
+    virtual ~WorkerContext() = default;
+};
 
 struct ModFile
 {
     Path relative_path;
-    common::Lazy<tl::expected<std::vector<std::byte>, common::Error>> content;
+    FileContent content;
+    /// Context of the thread processing the file, created by `ModFolderTransformer::make_worker_context`.
+    /// Null if the transformer has none, or if it is not called by `ModFolder::transform`.
+    WorkerContext *worker_context = nullptr;
+
+    /// `worker_context`, as the type created by the transformer. Null if there is none or if it has another
+    /// type, e.g. when the file is handed over by a transformer that is not the one that created the context.
+    template<class Context>
+    [[nodiscard]] auto context() const noexcept -> Context *
+    {
+        return dynamic_cast<Context *>(worker_context);
+    }
 };
 
 class ModFolderIteratorBase
@@ -44,6 +119,11 @@ public:
     virtual void failed_to_read_archive(const Path &archive_path) noexcept {}
 
     [[nodiscard]] virtual auto stop_requested() const noexcept -> bool { return false; }
+
+    /// \brief Whether the file at `relative_path` should be processed. Called for every file, so it must be
+    /// cheap, e.g. a check of the extension. Files that are not wanted are never read, and archives without
+    /// any wanted file are neither decompressed nor written again.
+    [[nodiscard]] virtual auto wants_file(const Path &relative_path) const noexcept -> bool { return true; }
 };
 
 class ModFolderTransformer : public ModFolderIteratorBase
@@ -55,6 +135,17 @@ public:
     [[nodiscard]] virtual auto transform_file(ModFile file) noexcept -> std::optional<std::vector<std::byte>>
                                                                         = 0;
 
+    /// \brief Creates the scratch state of a worker thread, handed to `transform_file` as
+    /// `ModFile::worker_context`. Called once per thread and `ModFolder::transform` run, by the thread
+    /// itself, before its first file.
+    /// As a thread processes one file at a time, its context can be used without any lock.
+    /// Contexts are destroyed once the run is over, by the thread that called `transform`. Buffers of
+    /// `common::BufferPool<T>::local()` they hold are then freed rather than given back to their pool.
+    [[nodiscard]] virtual auto make_worker_context() const noexcept -> std::unique_ptr<WorkerContext>
+    {
+        return nullptr;
+    }
+
     virtual void failed_to_write_transformed_file(const Path &relative_path,
                                                   std::span<const std::byte> content) noexcept
     {
@@ -70,6 +161,18 @@ public:
     }
 
     virtual void failed_to_change_archive_version(const Path &path, const common::Error &error) noexcept {}
+
+    /// \brief Hash of every setting that can change the output of `transform_file`.
+    /// Used with a manifest to skip files already transformed with the same settings.
+    /// If the function returns std::nullopt, the manifest is not used and all files are transformed.
+    [[nodiscard]] virtual auto settings_hash() const noexcept -> std::optional<std::uint64_t>
+    {
+        return std::nullopt;
+    }
+
+    /// \brief Stable identifier of the transformer, used with `settings_hash` to share outputs through a
+    /// TransformCache. If the function returns std::nullopt, the cache is not used.
+    [[nodiscard]] virtual auto id() const noexcept -> std::optional<std::u8string> { return std::nullopt; }
 };
 
 class ModFolderIterator : public ModFolderIteratorBase
@@ -78,33 +181,137 @@ public:
     virtual void process_file(ModFile file) noexcept = 0;
 };
 
+/// Number and size of a group of files
+struct FileStats
+{
+    std::size_t count{};
+    std::uint64_t bytes{};
+
+    auto operator+=(const FileStats &other) noexcept -> FileStats &
+    {
+        count += other.count;
+        bytes += other.bytes;
+        return *this;
+    }
+
+    [[nodiscard]] auto operator==(const FileStats &) const noexcept -> bool = default;
+};
+
+/// Overview of the files of a mod folder. \see ModFolder::census
+struct Census
+{
+    /// Files outside of archives, archives excluded
+    FileStats loose;
+    /// Files stored in archives. Their size is their size in the archive, which may be compressed.
+    FileStats archived;
+    FileStats archives;
+    /// Loose and archived files, by lowercase extension (e.g. `.dds`)
+    std::map<std::u8string, FileStats> extensions;
+    std::vector<Path> unreadable_archives;
+
+    [[nodiscard]] auto files() const noexcept -> FileStats
+    {
+        auto stats = loose;
+        stats += archived;
+        return stats;
+    }
+
+    auto operator+=(const Census &other) -> Census &;
+};
+
 class ModFolder
 {
 public:
     using enum ModFolderIteratorBase::ArchiveTooLargeAction;
     using enum ModFolderIteratorBase::ArchiveTooLargeState;
 
+    static constexpr std::uint64_t k_default_archive_window_size = 256ULL * 1024 * 1024;
+    static constexpr auto k_default_checkpoint_interval          = std::chrono::seconds(60);
+
     explicit ModFolder(Path directory, bsa::Settings bsa_settings, bool ignore_existing_archives = false);
 
-    /// Get the size of the folder, including files in archives.
-    /// Utility function, equivalent to iterate() and counting the files.
+    /// Get the number of files in the folder, including files in archives.
+    /// Utility function, equivalent to `census().files().count`.
     [[nodiscard]] auto size() noexcept -> size_t;
 
+    /// Count the files in the folder, including files in archives, without reading their content.
+    /// Only directory entries and archive indices are read, so this is fast enough to plan work or size a
+    /// progress bar. Multithreaded.
+    [[nodiscard]] auto census() noexcept -> Census;
+
     /// Transform all files in the folder, including files in archives.
     /// Multithreaded.
     void transform(ModFolderTransformer &transformer) noexcept;
 
     /// Iterate over all files in the folder, including files in archives.
-    /// Multithreaded.
+    /// Multithreaded. Read-only: archives are never converted nor written, so the folder can be read-only.
     void iterate(ModFolderIterator &iterator) noexcept;
 
     [[nodiscard]] auto name() const noexcept -> std::u8string { return dir_.filename().u8string(); }
     [[nodiscard]] auto path() const noexcept -> const Path & { return dir_; }
 
+    /// Limit the memory used by concurrent jobs, in bytes. Unlimited by default.
+    /// The peak memory of each file is estimated from its size and, for textures, from its header. Files are
+    /// only started while their estimate fits in the budget; smaller files are processed in the meantime.
+    void set_memory_budget(std::uint64_t bytes) noexcept { memory_budget_->set_limit(bytes); }
+
+    /// Limit the memory used by the files of an archive being transformed, in bytes.
+    /// Files are transformed in order, and a file is only started once the previous ones fit in this window.
+    void set_archive_window_size(std::uint64_t bytes) noexcept { archive_window_size_ = bytes; }
+
+    /// Enable incremental processing, using the manifest stored at `manifest_path`.
+    /// `transform` then skips files whose size, modification time or content did not change since they were
+    /// last transformed with the same settings, and saves the manifest when done.
+    /// \see ModFolderTransformer::settings_hash
+    void use_manifest(Path manifest_path) noexcept { manifest_.emplace(std::move(manifest_path)); }
+
+    /// Save the progress of `transform` regularly, so that an interrupted run resumes where it stopped.
+    /// Requires a manifest, which is then saved every `interval` instead of only at the end. Loose files are
+    /// written atomically, so that a crash never leaves a truncated file. Transformed files of archives are
+    /// staged next to the manifest until their archive is written, and reused by the next run otherwise.
+    /// \see use_manifest
+    void enable_checkpoints(std::chrono::seconds interval = k_default_checkpoint_interval) noexcept
+    {
+        checkpoint_interval_ = interval;
+    }
+
+    /// Reuse transform outputs stored in `cache`, and store new ones in it.
+    /// The cache must outlive the folder.
+    /// \see ModFolderTransformer::id
+    void use_cache(TransformCache &cache) noexcept { cache_ = &cache; }
+
+    /// Run jobs on `pool` instead of a pool owned by the folder, e.g. to share it between folders.
+    /// The pool must outlive the folder.
+    void use_thread_pool(common::ThreadPool &pool) noexcept { thread_pool_ = &pool; }
+
+    /// Drive archives from `pool` instead of a pool owned by the folder. An archive waits for the jobs of its
+    /// files, so it must not be the pool given to `use_thread_pool`. Its size bounds the number of archives
+    /// in flight. The pool must outlive the folder.
+    void use_archive_thread_pool(common::ThreadPool &pool) noexcept { archive_thread_pool_ = &pool; }
+
+    /// Admit jobs against `budget` instead of a budget owned by the folder, e.g. to share it between folders.
+    /// The budget must outlive the folder.
+    void use_memory_budget(common::MemoryBudget &budget) noexcept { memory_budget_ = &budget; }
+
 private:
+    /// The pool owned by the folder is only created if no other pool is used
+    [[nodiscard]] auto thread_pool() noexcept -> common::ThreadPool &;
+    [[nodiscard]] auto archive_thread_pool() noexcept -> common::ThreadPool &;
+
     Path dir_;
     bsa::Settings bsa_settings_;
     bool ignore_existing_archives_;
-    common::ThreadPool thread_pool_;
+    common::MemoryBudget own_memory_budget_;
+    common::MemoryBudget *memory_budget_ = &own_memory_budget_;
+    std::uint64_t archive_window_size_   = k_default_archive_window_size;
+    std::optional<Manifest> manifest_;
+    std::optional<std::chrono::seconds> checkpoint_interval_;
+    TransformCache *cache_ = nullptr;
+    std::once_flag thread_pool_created_;
+    std::unique_ptr<common::ThreadPool> own_thread_pool_;
+    common::ThreadPool *thread_pool_ = nullptr;
+    std::once_flag archive_thread_pool_created_;
+    std::unique_ptr<common::ThreadPool> own_archive_thread_pool_;
+    common::ThreadPool *archive_thread_pool_ = nullptr;
 };
 } // namespace btu::modmanager
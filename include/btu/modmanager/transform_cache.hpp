@@ -0,0 +1,74 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <btu/common/path.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace btu::modmanager {
+/// Identifies the output of a transformer for a given input
+struct CacheKey
+{
+    std::uint64_t input_hash{};
+    std::uint64_t input_size{};
+    /// Path of the file, relative to the mod folder. Transformers often behave differently depending on the
+    /// path (e.g. normal maps), so it is part of the key.
+    Path relative_path;
+    std::u8string transformer_id;
+    std::uint64_t settings_hash{};
+};
+
+struct CachedOutput
+{
+    /// std::nullopt if the transformer left the file unchanged
+    std::optional<std::vector<std::byte>> content;
+};
+
+/**
+ * \brief Content-addressed on-disk cache of transform outputs, meant to be shared by all mods of a machine.
+ *
+ * Each output is stored in its own file, so that multiple processes can share the same directory.
+ * When the cache grows larger than its maximum size, the least recently used outputs are evicted.
+ * \note Thread-safe.
+ */
+class TransformCache
+{
+public:
+    static constexpr std::uint64_t k_default_max_size = 10ULL * 1024 * 1024 * 1024;
+
+    explicit TransformCache(Path directory, std::uint64_t max_size = k_default_max_size) noexcept;
+
+    TransformCache(const TransformCache &)                     = delete;
+    auto operator=(const TransformCache &) -> TransformCache & = delete;
+
+    [[nodiscard]] auto find(const CacheKey &key) noexcept -> std::optional<CachedOutput>;
+
+    /// Stores the output of a transformer. `content` is std::nullopt if the file was left unchanged.
+    void store(const CacheKey &key, std::optional<std::span<const std::byte>> content) noexcept;
+
+    /// Evicts the least recently used outputs until the cache fits in `max_size`.
+    void prune() noexcept;
+
+    [[nodiscard]] auto size() const noexcept -> std::uint64_t { return size_; }
+    [[nodiscard]] auto max_size() const noexcept -> std::uint64_t { return max_size_; }
+    [[nodiscard]] auto directory() const noexcept -> const Path & { return dir_; }
+
+private:
+    [[nodiscard]] auto entry_path(const CacheKey &key) const noexcept -> Path;
+
+    Path dir_;
+    std::uint64_t max_size_;
+    std::atomic<std::uint64_t> size_ = 0;
+    std::mutex prune_mutex_;
+};
+} // namespace btu::modmanager
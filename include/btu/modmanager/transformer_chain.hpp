@@ -0,0 +1,65 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <btu/modmanager/mod_folder.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace btu::modmanager {
+/**
+ * \brief Runs several transformers in sequence on each file, as a single transformer.
+ *
+ * Each file is read once, handed to every transformer that wants it, each one receiving the output of the
+ * previous one, and written once. Used with `ModFolder::transform`, archives are thus rewritten at most once,
+ * however many transformers there are.
+ * \note The transformers must outlive the chain.
+ */
+class TransformerChain final : public ModFolderTransformer
+{
+public:
+    using Transformers = std::vector<std::reference_wrapper<ModFolderTransformer>>;
+
+    explicit TransformerChain(Transformers transformers) noexcept;
+
+    /// Skips the archive if any transformer wants to skip it
+    [[nodiscard]] auto archive_too_large(const Path &archive_path, ArchiveTooLargeState state) noexcept
+        -> ArchiveTooLargeAction override;
+
+    void failed_to_read_archive(const Path &archive_path) noexcept override;
+
+    [[nodiscard]] auto stop_requested() const noexcept -> bool override;
+    [[nodiscard]] auto wants_file(const Path &relative_path) const noexcept -> bool override;
+
+    [[nodiscard]] auto transform_file(ModFile file) noexcept
+        -> std::optional<std::vector<std::byte>> override;
+    /// Holds the context of each transformer
+    [[nodiscard]] auto make_worker_context() const noexcept -> std::unique_ptr<WorkerContext> override;
+
+    void failed_to_write_transformed_file(const Path &relative_path,
+                                          std::span<const std::byte> content) noexcept override;
+    void failed_to_read_transformed_file(const Path &relative_path,
+                                         std::span<const std::byte> content) noexcept override;
+    void failed_to_write_archive(const Path &old_archive_path,
+                                 const Path &new_archive_path) noexcept override;
+    void failed_to_change_archive_version(const Path &path, const common::Error &error) noexcept override;
+
+    /// Combines the hashes of all transformers, in order. std::nullopt if any of them has none.
+    [[nodiscard]] auto settings_hash() const noexcept -> std::optional<std::uint64_t> override;
+    /// Joins the ids of all transformers, in order. std::nullopt if any of them has none.
+    [[nodiscard]] auto id() const noexcept -> std::optional<std::u8string> override;
+
+private:
+    struct ChainContext final : WorkerContext
+    {
+        /// In the same order as the transformers
+        std::vector<std::unique_ptr<WorkerContext>> contexts;
+    };
+
+    Transformers transformers_;
+};
+} // namespace btu::modmanager
@@ -0,0 +1,46 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "btu/tex/detail/common.hpp"
+
+#include <array>
+#include <compare>
+#include <cstdint>
+
+namespace btu::tex {
+class Texture;
+
+/// Statistics on the pixels of every image of a texture, as 8 bit RGBA
+struct TextureAnalysis
+{
+    /// Lowest value of each channel, in RGBA order. Alpha is 255 for formats without alpha.
+    std::array<std::uint8_t, 4> min = {255, 255, 255, 255};
+    /// Highest value of each channel, in RGBA order
+    std::array<std::uint8_t, 4> max = {0, 0, 0, 0};
+    /// Every alpha is either 0 or 255
+    bool binary_alpha = true;
+    /// Red, green and blue are equal in every pixel
+    bool grayscale = true;
+    /// Lowest alpha counted as opaque. Lower for block compressed formats, as in DirectXTex.
+    std::uint8_t opaque_threshold = 255;
+
+    /// Same result as `ScratchImage::IsAlphaAllOpaque` on the analyzed texture
+    [[nodiscard]] auto opaque_alpha() const noexcept -> bool { return min[3] >= opaque_threshold; }
+    /// Every pixel has the same color and alpha
+    [[nodiscard]] auto uniform() const noexcept -> bool { return min == max; }
+
+    auto operator<=>(const TextureAnalysis &) const noexcept = default;
+};
+
+/**
+ * \brief Scans the pixels of `file` once.
+ *
+ * 8 bit RGBA formats are read as they are, and BC1 to BC5 and BC7 are decoded a strip at a time. Other
+ * formats are converted to R8G8B8A8 one image at a time.
+ */
+[[nodiscard]] auto analyze(const Texture &file) noexcept -> tl::expected<TextureAnalysis, Error>;
+} // namespace btu::tex
@@ -4,14 +4,22 @@
 #include "btu/tex/detail/common.hpp"
 #include "btu/tex/detail/formats_string.hpp"
 #include "btu/tex/dimension.hpp"
+#include "btu/tex/encoding_quality.hpp"
 
 #include <crunch/crn_dxt_image.h>
 #include <crunch/crn_texture_conversion.h>
 #include <crunch/dds_defs.h>
 
+#include <stop_token>
+
 namespace btu::tex {
 using crnlib::texture_conversion::convert_params;
 [[nodiscard]] auto resize(CrunchTexture &&file, Dimension dim) -> ResultCrunch;
 [[nodiscard]] auto generate_mipmaps(CrunchTexture &&file) -> ResultCrunch;
-[[nodiscard]] auto convert(CrunchTexture &&file, DXGI_FORMAT format) -> ResultCrunch;
+/// \param stop Checked through crunch progress reports while packing. Returns `TextureErr::Cancelled` when a
+/// stop is requested.
+[[nodiscard]] auto convert(CrunchTexture &&file,
+                           DXGI_FORMAT format,
+                           EncodingQuality quality     = EncodingQuality::Normal,
+                           const std::stop_token &stop = {}) -> ResultCrunch;
 } // namespace btu::tex
@@ -30,6 +30,8 @@ class CrunchTexture
 {
 public:
     void set(const mipmapped_texture &tex) noexcept;
+    /// Takes the content of `tex` without copying it. `tex` is left empty.
+    void set(mipmapped_texture &&tex) noexcept;
 
     [[nodiscard]] auto get() noexcept -> mipmapped_texture &;
     [[nodiscard]] auto get() const noexcept -> const mipmapped_texture &;
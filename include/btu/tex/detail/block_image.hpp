@@ -0,0 +1,22 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace btu::tex::detail {
+/// An RGBA8 image to encode, and where to write its blocks
+struct BlockImage
+{
+    const uint8_t *pixels;
+    size_t row_pitch;
+    uint32_t width;
+    uint32_t height;
+    /// Rows of blocks are expected to be tightly packed
+    uint8_t *blocks;
+};
+} // namespace btu::tex::detail
@@ -0,0 +1,34 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "btu/tex/detail/block_image.hpp"
+#include "btu/tex/encoding_quality.hpp"
+#include "btu/tex/error_code.hpp"
+
+#include <tl/expected.hpp>
+
+#include <cstdint>
+#include <span>
+#include <stop_token>
+
+// bc7enc and DirectXTex both define DXGI_FORMAT, so the BC7 encoder lives in its own translation unit and
+// only plain types cross this boundary.
+// We use another library because DirectXTex BC7 CPU encoder is unbearably slow.
+namespace btu::tex::detail {
+/**
+ * \brief Encodes images to BC7, using every core, unless called from a thread pool worker.
+ *
+ * Large images are encoded a strip at a time, each strip using every core. Smaller images, such as small mips
+ * or the faces of a small cubemap, do not have enough blocks to do so, and are encoded concurrently instead.
+ * \param quality Trades encoding speed for fewer artifacts. `Normal` keeps the encoder defaults.
+ * \param stop Checked between strips and small images. Returns `TextureErr::Cancelled` when a stop is
+ * requested.
+ */
+[[nodiscard]] auto convert_bc7(std::span<const BlockImage> images,
+                               EncodingQuality quality,
+                               const std::stop_token &stop) -> tl::expected<void, Error>;
+} // namespace btu::tex::detail
@@ -0,0 +1,60 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "btu/tex/detail/block_image.hpp"
+#include "btu/tex/detail/simd.hpp"
+#include "btu/tex/dxtex.hpp"
+#include "btu/tex/encoding_quality.hpp"
+#include "btu/tex/error_code.hpp"
+
+#include <tl/expected.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stop_token>
+
+namespace btu::tex::detail {
+enum class BcFormat : std::uint8_t
+{
+    Bc1,
+    Bc3,
+    Bc4,
+    Bc5,
+};
+
+/// \return The format to give to `convert_bcn`, if it can encode `format`
+[[nodiscard]] constexpr auto to_bc_format(DXGI_FORMAT format) noexcept -> std::optional<BcFormat>
+{
+    switch (format)
+    {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB: return BcFormat::Bc1;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB: return BcFormat::Bc3;
+        case DXGI_FORMAT_BC4_UNORM: return BcFormat::Bc4;
+        case DXGI_FORMAT_BC5_UNORM: return BcFormat::Bc5;
+        default: return std::nullopt;
+    }
+}
+
+/**
+ * \brief Encodes images to BC1, BC3, BC4 or BC5, using every core, unless called from a thread pool worker.
+ *
+ * Endpoints are fitted along the principal axis of each block, then refined by least squares. `Fast` uses the
+ * bounding box of the block instead, and `Max` refines further and tries every BC4 mode.
+ * BC1 uses its three colors mode for blocks with pixels of alpha lower than 128, which are left transparent.
+ * BC4 encodes the red channel, and BC5 the red and green ones.
+ * \param stop Checked between rows of blocks. Returns `TextureErr::Cancelled` when a stop is requested.
+ * \param isa Limits the kernels used, for benchmarks. Kernels the CPU does not support are never used.
+ */
+[[nodiscard]] auto convert_bcn(std::span<const BlockImage> images,
+                               BcFormat format,
+                               EncodingQuality quality,
+                               const std::stop_token &stop,
+                               InstructionSet isa = best_instruction_set()) -> tl::expected<void, Error>;
+} // namespace btu::tex::detail
@@ -0,0 +1,47 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "btu/tex/detail/simd.hpp"
+#include "btu/tex/dxtex.hpp"
+
+#include <optional>
+#include <span>
+
+namespace btu::tex::detail {
+/// \return The format DirectXTex decompresses `format` to, if `decompress_bcn` can decode it
+[[nodiscard]] constexpr auto bcn_decoded_format(DXGI_FORMAT format) noexcept -> std::optional<DXGI_FORMAT>
+{
+    switch (format)
+    {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC7_UNORM: return DXGI_FORMAT_R8G8B8A8_UNORM;
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC7_UNORM_SRGB: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        case DXGI_FORMAT_BC4_UNORM: return DXGI_FORMAT_R8_UNORM;
+        case DXGI_FORMAT_BC5_UNORM: return DXGI_FORMAT_R8G8_UNORM;
+        default: return std::nullopt;
+    }
+}
+
+/**
+ * \brief Decodes BC1, BC2, BC3, BC4, BC5 and BC7 images, using every core, unless called from a thread pool
+ * worker.
+ *
+ * Results are the same as DirectXTex's.
+ * \param targets One per source, of the same size. Either in the format given by `bcn_decoded_format`, or in
+ * R8G8B8A8, where missing channels are 0 and alpha 255.
+ * \param isa Limits the kernels used, for benchmarks and tests. Kernels the CPU does not support are never
+ * used.
+ */
+void decompress_bcn(std::span<const DirectX::Image> sources,
+                    std::span<const DirectX::Image> targets,
+                    InstructionSet isa = best_instruction_set());
+} // namespace btu::tex::detail
@@ -0,0 +1,32 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <btu/common/threading.hpp>
+
+#if _OPENMP
+#include <omp.h>
+#endif
+
+namespace btu::tex::detail {
+/**
+ * \brief Number of threads for the OpenMP loops of encoders and decoders.
+ *
+ * Workers of a `common::ThreadPool`, e.g. in `ModFolder::transform`, already process a texture each. A team
+ * of every core on each of them would run pool size times cores threads, so their loops stay on the worker.
+ * Nested loops are not split either.
+ */
+[[nodiscard]] inline auto omp_thread_count() noexcept -> int
+{
+#if _OPENMP
+    if (BS::this_thread::get_index().has_value() || omp_get_level() > 0)
+        return 1;
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+} // namespace btu::tex::detail
@@ -0,0 +1,38 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BTU_BCN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define BTU_BCN_X86 0
+#endif
+
+// GCC and Clang only allow intrinsics in functions built for their instruction set
+#if defined(__GNUC__) || defined(__clang__)
+#define BTU_BCN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BTU_BCN_TARGET(isa)
+#endif
+
+namespace btu::tex::detail {
+/// Instruction sets `convert_bcn` and `decompress_bcn` have kernels for, from the least to the most capable
+enum class InstructionSet : std::uint8_t
+{
+    Scalar,
+    Sse41,
+    Avx2,
+};
+
+/// \return The most capable instruction set supported by this CPU
+[[nodiscard]] auto best_instruction_set() noexcept -> InstructionSet;
+} // namespace btu::tex::detail
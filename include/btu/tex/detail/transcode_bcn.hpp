@@ -0,0 +1,47 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "btu/tex/dxtex.hpp"
+
+#include <cstdint>
+#include <optional>
+
+namespace btu::tex::detail {
+/// Format changes done by rewriting each block, instead of decoding and encoding the image
+enum class Transcoding : std::uint8_t
+{
+    /// The color half of BC3 blocks whose alpha is opaque is a BC1 block. Lossless.
+    Bc3ToBc1,
+    /// BC1 blocks with four colors are mapped to BC7 mode 6 blocks. Endpoints are rounded to odd values, as
+    /// their alpha must be 255, and interpolated colors move by less than a percent of the endpoints range.
+    Bc1ToBc7,
+};
+
+[[nodiscard]] constexpr auto find_transcoding(DXGI_FORMAT source, DXGI_FORMAT target) noexcept
+    -> std::optional<Transcoding>
+{
+    const auto is = [&](DXGI_FORMAT from, DXGI_FORMAT to) { return source == from && target == to; };
+
+    if (is(DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC1_UNORM)
+        || is(DXGI_FORMAT_BC3_UNORM_SRGB, DXGI_FORMAT_BC1_UNORM_SRGB))
+        return Transcoding::Bc3ToBc1;
+    if (is(DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC7_UNORM)
+        || is(DXGI_FORMAT_BC1_UNORM_SRGB, DXGI_FORMAT_BC7_UNORM_SRGB))
+        return Transcoding::Bc1ToBc7;
+    return std::nullopt;
+}
+
+/// \return Whether every block of `image` can be rewritten. BC3 blocks need an opaque alpha, and BC1
+/// blocks four colors, or a single one.
+[[nodiscard]] auto can_transcode_blocks(Transcoding transcoding, const DirectX::Image &image) noexcept
+    -> bool;
+
+/// \param target Of the same size as `source`, in the target format. Requires `can_transcode_blocks`.
+void transcode_blocks(Transcoding transcoding,
+                      const DirectX::Image &source,
+                      const DirectX::Image &target) noexcept;
+} // namespace btu::tex::detail
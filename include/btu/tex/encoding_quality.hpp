@@ -0,0 +1,40 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <btu/common/json.hpp>
+
+#include <cstdint>
+
+namespace btu::tex {
+/// Trades encoding time for quality. Each encoder (bc7enc, DirectXTex and crunch) maps it to its own
+/// settings. Kept free of DirectXTex, as the bc7enc translation unit cannot include it.
+enum class EncodingQuality : std::uint8_t
+{
+    /// For previews: much faster, with visible artifacts on gradients
+    Fast,
+    /// The defaults of each encoder
+    Normal,
+    /// For releases: the most exhaustive search of each encoder, several times slower than `Normal`
+    Max,
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(EncodingQuality,
+                             {{EncodingQuality::Fast, "fast"},
+                              {EncodingQuality::Normal, "normal"},
+                              {EncodingQuality::Max, "max"}});
+
+/// CPU encoder used for BC1, BC3, BC4 and BC5. BC7 always uses bc7enc.
+enum class BcEncoder : std::uint8_t
+{
+    DirectXTex,
+    /// Our own encoder, using SSE4.1 or AVX2 when the CPU supports them
+    Builtin,
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(BcEncoder,
+                             {{BcEncoder::DirectXTex, "directxtex"}, {BcEncoder::Builtin, "builtin"}});
+} // namespace btu::tex
@@ -16,6 +16,8 @@ enum class TextureErr : std::uint8_t
     MemoryAllocation,
     WriteFailure,
     ReadFailure,
+    /// A stop was requested through a `std::stop_token`
+    Cancelled,
 };
 } // namespace btu::tex
 
@@ -6,11 +6,39 @@
 #include "btu/tex/texture.hpp"
 
 #include <btu/tex/compression_device.hpp>
+#include <btu/tex/encoding_quality.hpp>
+
+#include <optional>
+#include <stop_token>
 
 namespace btu::tex {
 [[nodiscard]] auto decompress(Texture &&file) -> Result;
 [[nodiscard]] auto make_transparent_alpha(Texture &&file) -> Result;
-[[nodiscard]] auto convert(Texture &&file, DXGI_FORMAT format, CompressionDevice &dev) -> Result;
+/// \param quality Only used when compressing
+/// \param encoder Used when compressing to BC1, BC3, BC4 or BC5
+/// \param stop Checked before starting, and between strips of block rows when encoding BC7 or using the
+/// builtin encoder. Returns `TextureErr::Cancelled` when a stop is requested.
+[[nodiscard]] auto convert(Texture &&file,
+                           DXGI_FORMAT format,
+                           CompressionDevice &dev,
+                           EncodingQuality quality     = EncodingQuality::Normal,
+                           BcEncoder encoder           = BcEncoder::DirectXTex,
+                           const std::stop_token &stop = {}) -> Result;
+
+/**
+ * \brief Whether `transcode` can convert `file` to `format`.
+ *
+ * Supported: BC3 with an opaque alpha to BC1, and BC1 to BC7 when every block uses four colors, or a single
+ * opaque one. Every block is checked.
+ */
+[[nodiscard]] auto can_transcode(const Texture &file, DXGI_FORMAT format) noexcept -> bool;
+/// Same as `convert`, but rewrites each block instead of decoding and encoding the texture. Fails with
+/// `TextureErr::BadInput` if `can_transcode` returns false.
+[[nodiscard]] auto transcode(Texture &&file, DXGI_FORMAT format) -> Result;
+
+/// DirectXTex flags used to compress to `format` on the CPU at `quality`
+[[nodiscard]] auto compression_flags(DXGI_FORMAT format, EncodingQuality quality) noexcept
+    -> DirectX::TEX_COMPRESS_FLAGS;
 
 [[nodiscard]] constexpr auto optimal_mip_count(Dimension dim) noexcept -> size_t
 {
@@ -27,4 +55,15 @@ namespace btu::tex {
 
 [[nodiscard]] auto generate_mipmaps(Texture &&file) -> Result;
 [[nodiscard]] auto resize(Texture &&file, Dimension dim) -> Result;
+
+/**
+ * \brief Number of top mips to drop for the texture to be `target` sized, if its existing mips can be kept.
+ *
+ * Only set when one of the mips is exactly `target` sized and the mip chain is complete, so that the result
+ * has a complete mip chain too. 3D textures are not supported.
+ */
+[[nodiscard]] auto droppable_mips(const TexMetadata &info, Dimension target) noexcept
+    -> std::optional<size_t>;
+/// Removes the `count` largest mips of every face and array item. Blocks are copied as is, without decoding.
+[[nodiscard]] auto drop_mips(Texture &&file, size_t count) -> Result;
 } // namespace btu::tex
@@ -5,14 +5,19 @@
 
 #pragma once
 
+#include "btu/tex/analysis.hpp"
 #include "btu/tex/detail/common.hpp"
 #include "btu/tex/dimension.hpp"
+#include "btu/tex/encoding_quality.hpp"
 #include "btu/tex/formats.hpp"
 #include "compression_device.hpp"
 
 #include <btu/common/games.hpp>
 #include <btu/common/json.hpp>
+#include <btu/common/path.hpp>
 
+#include <span>
+#include <stop_token>
 #include <variant>
 
 namespace btu::tex {
@@ -35,17 +40,36 @@ struct Settings
     BestFormatFor output_format;
 
     std::vector<std::u8string> landscape_textures;
+
+    EncodingQuality quality = EncodingQuality::Normal;
+    BcEncoder bc_encoder    = BcEncoder::DirectXTex;
 };
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Settings,
-                                   game,
-                                   compress,
-                                   resize,
-                                   mipmaps,
-                                   use_format_whitelist,
-                                   allowed_formats,
-                                   output_format,
-                                   landscape_textures)
+// Missing keys keep their default value, so settings saved before a field was added still load
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Settings,
+                                                game,
+                                                compress,
+                                                resize,
+                                                mipmaps,
+                                                use_format_whitelist,
+                                                allowed_formats,
+                                                output_format,
+                                                landscape_textures,
+                                                quality,
+                                                bc_encoder)
+
+/// Pixels statistics of the texture steps were planned for
+struct SourceAnalysis : TextureAnalysis
+{
+    Dimension dimension{};
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+
+    /// Whether `file` has the dimensions and format of the analyzed texture.
+    /// Pixels are not compared: the analysis must not be reused for a texture whose pixels were modified.
+    [[nodiscard]] auto describes(const Texture &file) const noexcept -> bool;
+
+    auto operator<=>(const SourceAnalysis &) const noexcept = default;
+};
 
 struct OptimizationSteps
 {
@@ -54,16 +78,85 @@ struct OptimizationSteps
     bool mipmaps               = false;
     DXGI_FORMAT best_format    = DXGI_FORMAT_UNKNOWN;
     bool convert               = false;
+    EncodingQuality quality    = EncodingQuality::Normal;
+    BcEncoder bc_encoder       = BcEncoder::DirectXTex;
+    /// Pixels statistics computed while planning, reused by `optimize` when it is given the same texture.
+    /// Only set for formats with alpha.
+    std::optional<SourceAnalysis> analysis;
 
     auto operator<=>(const OptimizationSteps &) const noexcept = default;
 };
 
-[[nodiscard]] auto optimize(Texture &&file, OptimizationSteps sets, CompressionDevice &dev) noexcept -> Result;
+/// \param stop Checked between steps and during conversion. Returns `TextureErr::Cancelled` when a stop is
+/// requested.
+[[nodiscard]] auto optimize(Texture &&file,
+                            OptimizationSteps sets,
+                            CompressionDevice &dev,
+                            const std::stop_token &stop = {}) noexcept -> Result;
 [[nodiscard]] auto optimize(CrunchTexture &&file,
                             OptimizationSteps sets,
-                            CompressionDevice &dev) noexcept -> ResultCrunch;
+                            CompressionDevice &dev,
+                            const std::stop_token &stop = {}) noexcept -> ResultCrunch;
+
+/**
+ * \brief Whether `optimize_fused` can process `file` in a single pass.
+ *
+ * Supported: 2D textures, without array or cube faces, in an 8 bit RGBA or BC format, which are not enlarged.
+ * Mipmaps require power of two dimensions, and existing mipmaps must be dropped or regenerated.
+ * BC7 output is only supported when no GPU is available, as the GPU encoder works on whole images.
+ */
+[[nodiscard]] auto can_optimize_fused(const Texture &file,
+                                      const OptimizationSteps &sets,
+                                      const CompressionDevice &dev) noexcept -> bool;
+
+/**
+ * \brief Same as `optimize`, but streams the texture through all the steps instead of running them one after
+ * the other.
+ *
+ * Rows of the top mip are decoded, resized with an area filter, have their alpha fixed, are reduced into the
+ * smaller mips and encoded a strip at a time. Scratch memory is bounded by a few strips of the texture,
+ * instead of several copies of the whole texture, some of them as floats.
+ * The result is not bit-identical to `optimize`, as resizing and mipmaps use different filters.
+ * Falls back to `optimize` when `can_optimize_fused` returns false.
+ */
+[[nodiscard]] auto optimize_fused(Texture &&file,
+                                  OptimizationSteps sets,
+                                  CompressionDevice &dev,
+                                  const std::stop_token &stop = {}) noexcept -> Result;
 [[nodiscard]] auto compute_optimization_steps(const Texture &file,
                                               const Settings &sets) noexcept -> OptimizationSteps;
 [[nodiscard]] auto compute_optimization_steps(const CrunchTexture &file,
                                               const Settings &sets) noexcept -> OptimizationSteps;
+
+/// What can be known about a texture from its DDS or TGA header, without loading its pixels
+struct TextureHeader
+{
+    Dimension dimension;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    size_t mip_count   = 0;
+    bool cubemap       = false;
+    /// Steps planned from the header. If `needs_pixels`, they assume alpha is not opaque.
+    OptimizationSteps steps;
+    /// The steps depend on whether alpha is opaque, so `compute_optimization_steps` must run on the loaded
+    /// texture
+    bool needs_pixels = false;
+
+    /// Whether `optimize` may change the texture. False means the texture can be skipped without loading it.
+    [[nodiscard]] auto needs_work() const noexcept -> bool;
+
+    auto operator<=>(const TextureHeader &) const noexcept = default;
+};
+
+/**
+ * \brief Plans the steps for the texture at `path` from its header only.
+ *
+ * Steps match `compute_optimization_steps`, except for `OptimizationSteps::analysis`, when `needs_pixels` is
+ * false. Pixels are only needed for textures with alpha, when a step depends on alpha being opaque.
+ */
+[[nodiscard]] auto inspect(const Path &path,
+                           const Settings &sets) noexcept -> tl::expected<TextureHeader, Error>;
+/// Same as above, for a file already in memory. `relative_path` is used as the load path.
+[[nodiscard]] auto inspect(const Path &relative_path,
+                           std::span<const std::byte> data,
+                           const Settings &sets) noexcept -> tl::expected<TextureHeader, Error>;
 } // namespace btu::tex
@@ -61,4 +61,10 @@ private:
 [[nodiscard]] auto save(const Texture &tex, const Path &path) noexcept -> ResultError;
 [[nodiscard]] auto save(const Texture &tex) noexcept -> tl::expected<std::vector<std::byte>, Error>;
 
+/// Estimates the peak memory, in bytes, needed to process a texture described by `info`.
+/// This is a heuristic, meant for scheduling: it assumes a few RGBA8 copies of the whole texture.
+[[nodiscard]] auto estimate_memory_usage(const TexMetadata &info) noexcept -> size_t;
+/// Same as above, but reads only the header of the DDS or TGA file at `path`.
+[[nodiscard]] auto estimate_memory_usage(const Path &path) noexcept -> tl::expected<size_t, Error>;
+
 } // namespace btu::tex
@@ -9,11 +9,13 @@
 #include "btu/bsa/settings.hpp"
 
 #include <btu/common/algorithms.hpp>
+#include <btu/common/filesystem.hpp>
 #include <btu/common/functional.hpp>
 #include <btu/common/threading.hpp>
 #include <flux.hpp>
 
 #include <functional>
+#include <tuple>
 
 namespace btu::bsa {
 auto get_allow_file_pred(const PackSettings &sets) -> AllowFilePred
@@ -50,20 +52,37 @@ struct PackGroup
 {
     constexpr std::array allowed_types = {FileTypes::Standard, FileTypes::Texture, FileTypes::Incompressible};
 
-    auto packable_files = flux::from_range(fs::recursive_directory_iterator(dir))
-                              .filter([&](const auto &p) {
-                                  // filter out empty files
-                                  return p.is_regular_file() && p.file_size() > 0 && allow_path_pred(dir, p)
-                                         && common::contains(allowed_types, get_filetype(p, dir, sets));
-                              })
-                              .map([](const auto &p) { return p.path(); })
-                              .to<std::vector>();
+    struct SizedPath
+    {
+        Path path;
+        std::uintmax_t size;
+    };
 
-    // sort by size, largest first
-    std::ranges::sort(packable_files, [](const auto &lhs, const auto &rhs) {
-        return fs::file_size(lhs) > fs::file_size(rhs);
+    // The folder is listed in parallel, and each size is only queried once instead of at every comparison
+    auto sized_files = flux::from_range(common::list_files_mt(dir))
+                           .map([](const Path &p) {
+                               const auto entry = fs::directory_entry(p);
+                               auto ec          = std::error_code{};
+                               return std::pair{entry, entry.file_size(ec)};
+                           })
+                           .filter([&](const auto &p) {
+                               // filter out empty files
+                               return p.second > 0 && allow_path_pred(dir, p.first)
+                                      && common::contains(allowed_types, get_filetype(p.first, dir, sets));
+                           })
+                           .map([](auto &&p) { return SizedPath{p.first.path(), p.second}; })
+                           .to<std::vector>();
+
+    // sort by size, largest first. The listing order is not deterministic, so equal sizes are sorted by path
+    // to always produce the same archives.
+    std::ranges::sort(sized_files, [](const SizedPath &lhs, const SizedPath &rhs) {
+        return std::tie(rhs.size, lhs.path) < std::tie(lhs.size, rhs.path);
     });
 
+    auto packable_files = flux::from_range(sized_files)
+                              .map([](auto &&p) { return BTU_MOV(p.path); })
+                              .to<std::vector>();
+
     // if we have separate texture archives, partition textures and standard files
     if (sets.has_texture_version)
     {
@@ -1,8 +1,26 @@
 
 #include <btu/common/filesystem.hpp>
+#include <btu/common/threading.hpp>
 #include <flux.hpp>
 
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 namespace btu::common {
 auto read_file(const Path &a_path) noexcept -> tl::expected<std::vector<std::byte>, Error>
@@ -38,6 +56,102 @@ auto write_file(const Path &a_path,
     return {};
 }
 
+auto MappedFile::open(const Path &path) noexcept -> tl::expected<MappedFile, Error>
+{
+    auto ec         = std::error_code{};
+    const auto size = file_size(path, ec);
+    if (ec)
+        return tl::make_unexpected(Error(ec));
+
+    auto file  = MappedFile{};
+    file.size_ = size;
+    if (size == 0)
+        return file; // Empty files cannot be mapped
+
+#ifdef _WIN32
+    const auto last_error = [] {
+        return Error(std::error_code{static_cast<int>(GetLastError()), std::system_category()});
+    };
+
+    const auto handle = CreateFileW(path.c_str(),
+                                    GENERIC_READ,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr,
+                                    OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL,
+                                    nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return tl::make_unexpected(last_error());
+
+    // The mapping keeps the file open, we do not need the handle anymore
+    file.mapping_ = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(handle);
+    if (file.mapping_ == nullptr)
+        return tl::make_unexpected(last_error());
+
+    file.data_ = static_cast<const std::byte *>(MapViewOfFile(file.mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (file.data_ == nullptr)
+        return tl::make_unexpected(last_error());
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return tl::make_unexpected(Error(std::error_code{errno, std::system_category()}));
+
+    // The mapping keeps the file open, we do not need the descriptor anymore
+    void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return tl::make_unexpected(Error(std::error_code{errno, std::system_category()}));
+
+    file.data_ = static_cast<const std::byte *>(data);
+#endif
+    return file;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+#ifdef _WIN32
+    , mapping_(std::exchange(other.mapping_, nullptr))
+#endif
+{
+}
+
+auto MappedFile::operator=(MappedFile &&other) noexcept -> MappedFile &
+{
+    if (this != &other)
+    {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::close() noexcept
+{
+#ifdef _WIN32
+    if (data_ != nullptr)
+        UnmapViewOfFile(data_);
+    if (mapping_ != nullptr)
+        CloseHandle(mapping_);
+    mapping_ = nullptr;
+#else
+    if (data_ != nullptr)
+        ::munmap(const_cast<std::byte *>(data_), size_); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
 auto write_file_new(const Path &a_path,
                     const std::span<const std::byte> data) noexcept -> tl::expected<void, Error>
 {
@@ -162,6 +276,147 @@ auto hard_link(const Path &from, const Path &to) noexcept -> tl::expected<void,
     }
 }
 
+namespace {
+/// Calls `on_file` for each regular file and `on_dir` for each subdirectory of `dir`
+template<typename OnFile, typename OnDir>
+void read_directory(const Path &dir, OnFile &&on_file, OnDir &&on_dir) noexcept
+{
+#ifdef __linux__
+    // getdents64 gives us the type of most entries, so unlike directory_iterator we need no stat per entry
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    constexpr size_t k_buffer_size = 64 * 1024;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+    alignas(dirent64) std::array<char, k_buffer_size> buffer;
+
+    while (true)
+    {
+        const auto read = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (read <= 0)
+            break;
+
+        for (long offset = 0; offset < read;)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            const auto *entry = reinterpret_cast<const dirent64 *>(buffer.data() + offset);
+            offset += entry->d_reclen;
+
+            const auto name = std::string_view(static_cast<const char *>(entry->d_name));
+            if (name == "." || name == "..")
+                continue;
+
+            auto type = entry->d_type;
+            if (type == DT_UNKNOWN || type == DT_LNK)
+            {
+                // Some file systems do not fill d_type. Symbolic links are only followed for files
+                struct stat st = {};
+                const int flags = type == DT_UNKNOWN ? AT_SYMLINK_NOFOLLOW : 0;
+                if (::fstatat(fd, entry->d_name, &st, flags) != 0)
+                    continue;
+
+                if (S_ISREG(st.st_mode))
+                    type = DT_REG;
+                else if (S_ISDIR(st.st_mode) && type == DT_UNKNOWN)
+                    type = DT_DIR;
+                else
+                    continue;
+            }
+
+            if (type == DT_REG)
+                on_file(dir / name);
+            else if (type == DT_DIR)
+                on_dir(dir / name);
+        }
+    }
+    ::close(fd);
+#else
+    // On Windows, the directory iterator gets the attributes with the name, so there is no stat to avoid
+    auto ec = std::error_code{};
+    for (auto it = fs::directory_iterator(dir, ec); !ec && it != fs::directory_iterator{}; it.increment(ec))
+    {
+        auto entry_ec = std::error_code{};
+        if (it->is_symlink(entry_ec))
+        {
+            if (it->is_regular_file(entry_ec))
+                on_file(it->path());
+        }
+        else if (it->is_directory(entry_ec))
+            on_dir(it->path());
+        else if (it->is_regular_file(entry_ec))
+            on_file(it->path());
+    }
+#endif
+}
+} // namespace
+
+auto walk_files_mt(Path dir) noexcept -> std::pair<std::jthread, PathReceiver>
+{
+    auto channel = mpsc::Channel<Path>::make();
+    auto sender  = std::get<0>(channel);
+
+    auto walk = [dir = std::move(dir), sender = std::move(sender)](std::stop_token stop) mutable {
+        std::mutex mutex;
+        std::condition_variable cv;
+        auto pending = std::vector<Path>{std::move(dir)}; // used as a stack, to keep it small
+        size_t busy  = 0;
+
+        auto work = [&, sender]() mutable {
+            while (true)
+            {
+                auto current = Path{};
+                {
+                    auto lock = std::unique_lock{mutex};
+                    cv.wait(lock, [&] { return !pending.empty() || busy == 0; });
+                    if (pending.empty() || stop.stop_requested())
+                        break;
+
+                    current = std::move(pending.back());
+                    pending.pop_back();
+                    ++busy;
+                }
+
+                auto subdirs = std::vector<Path>{};
+                read_directory(
+                    current,
+                    [&](Path file) { sender.send(std::move(file)); },
+                    [&](Path subdir) { subdirs.emplace_back(std::move(subdir)); });
+
+                {
+                    const auto lock = std::lock_guard{mutex};
+                    std::ranges::move(subdirs, std::back_inserter(pending));
+                    --busy;
+                }
+                cv.notify_all();
+            }
+            cv.notify_all();
+        };
+
+        {
+            // Network drives benefit from many requests in flight, even more than local drives
+            auto workers = std::vector<std::jthread>{};
+            for (unsigned i = 1; i < hardware_concurrency(); ++i)
+                workers.emplace_back(work);
+            work();
+        }
+        sender.close();
+    };
+    auto walker = std::jthread(std::move(walk));
+
+    return std::pair{std::move(walker), std::get<1>(std::move(channel))};
+}
+
+auto list_files_mt(const Path &dir) noexcept -> std::vector<Path>
+{
+    auto [walker, receiver] = walk_files_mt(dir);
+
+    auto files = std::vector<Path>{};
+    for (auto &&file : receiver)
+        files.emplace_back(std::move(file));
+    return files;
+}
+
 auto find_matching_paths_icase(const Path &directory,
                                std::span<const Path> relative_lowercase_paths) noexcept -> std::vector<Path>
 {
@@ -0,0 +1,185 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/duplicates.hpp"
+
+#include <btu/common/filesystem.hpp>
+#include <btu/common/hash.hpp>
+#include <btu/common/threading.hpp>
+
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <map>
+#include <optional>
+#include <ranges>
+
+namespace btu::modmanager {
+namespace {
+/// Hashes the first `max_bytes` bytes of a file. std::nullopt if it cannot be read.
+[[nodiscard]] auto hash_prefix(const Path &path, std::uint64_t max_bytes) noexcept
+    -> std::optional<std::uint64_t>
+{
+    const auto file = common::MappedFile::open(path);
+    if (!file)
+        return std::nullopt;
+
+    const auto data = file->data();
+    return common::hash(data.first(std::min<std::uint64_t>(data.size(), max_bytes)));
+}
+
+/// Splits each group by the hash of the first `max_bytes` bytes of its files. Unique files are dropped.
+[[nodiscard]] auto split_by_hash(common::ThreadPool &pool,
+                                 std::vector<DuplicateGroup> groups,
+                                 std::uint64_t max_bytes) noexcept -> std::vector<DuplicateGroup>
+{
+    // Everything is queued first, so that the pool stays busy across groups
+    auto hashes = std::vector<std::vector<std::future<std::optional<std::uint64_t>>>>{};
+    for (const auto &group : groups)
+    {
+        auto &futs = hashes.emplace_back();
+        for (const auto &path : group.files)
+            futs.push_back(pool.submit_task([&path, max_bytes] { return hash_prefix(path, max_bytes); }));
+    }
+
+    auto result = std::vector<DuplicateGroup>{};
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        auto by_hash = std::map<std::uint64_t, std::vector<Path>>{};
+        for (size_t j = 0; j < groups[i].files.size(); ++j)
+        {
+            if (const auto hash = hashes[i][j].get())
+                by_hash[*hash].emplace_back(std::move(groups[i].files[j]));
+        }
+
+        for (auto &files : by_hash | std::views::values)
+        {
+            if (files.size() > 1)
+                result.push_back(DuplicateGroup{.size = groups[i].size, .files = std::move(files)});
+        }
+    }
+    return result;
+}
+
+/// Replaces `duplicate` with a hard link to `original`, if they have the same content
+[[nodiscard]] auto replace_with_hard_link(const Path &original,
+                                          std::span<const std::byte> original_content,
+                                          const Path &duplicate) noexcept -> tl::expected<bool, common::Error>
+{
+    {
+        const auto content = common::MappedFile::open(duplicate);
+        if (!content)
+            return tl::make_unexpected(content.error());
+        if (!std::ranges::equal(content->data(), original_content))
+            return false;
+    }
+
+    // Linking next to the duplicate then renaming it replaces the duplicate atomically
+    auto temp = duplicate;
+    temp += u8".btu-link";
+    if (const auto res = common::hard_link(original, temp); !res)
+        return tl::make_unexpected(res.error());
+
+    auto ec = std::error_code{};
+    // `hard_link` falls back to copying, e.g. across drives, which would not save anything
+    if (!fs::equivalent(original, temp, ec))
+        ec = std::make_error_code(std::errc::cross_device_link);
+    if (!ec)
+        fs::rename(temp, duplicate, ec);
+
+    if (ec)
+    {
+        auto ignored = std::error_code{};
+        fs::remove(temp, ignored);
+        return tl::make_unexpected(common::Error(ec));
+    }
+    return true;
+}
+} // namespace
+
+auto find_duplicates(std::span<const Path> dirs,
+                     std::uint64_t min_size) noexcept -> std::vector<DuplicateGroup>
+{
+    auto by_size = std::map<std::uint64_t, std::vector<Path>>{};
+    for (const auto &dir : dirs)
+    {
+        for (auto &&path : common::walk_files_mt(dir).second)
+        {
+            auto ec         = std::error_code{};
+            const auto size = static_cast<std::uint64_t>(fs::file_size(path, ec));
+            if (!ec && size > 0 && size >= min_size)
+                by_size[size].emplace_back(std::move(path));
+        }
+    }
+
+    auto candidates = std::vector<DuplicateGroup>{};
+    for (auto &[size, files] : by_size)
+    {
+        // The same file can be found twice if `dirs` overlap
+        std::ranges::sort(files);
+        const auto [first, last] = std::ranges::unique(files);
+        files.erase(first, last);
+
+        if (files.size() > 1)
+            candidates.push_back(DuplicateGroup{.size = size, .files = std::move(files)});
+    }
+
+    auto pool = common::make_thread_pool();
+    auto dups = split_by_hash(pool, std::move(candidates), k_partial_hash_size);
+
+    // Small files were already hashed whole
+    const auto larger = std::ranges::partition(dups, [](const DuplicateGroup &group) {
+        return group.size <= k_partial_hash_size;
+    });
+    auto to_hash = std::vector(std::make_move_iterator(larger.begin()),
+                               std::make_move_iterator(larger.end()));
+    dups.erase(larger.begin(), larger.end());
+
+    auto large = split_by_hash(pool, std::move(to_hash), std::numeric_limits<std::uint64_t>::max());
+    dups.insert(dups.end(), std::make_move_iterator(large.begin()), std::make_move_iterator(large.end()));
+
+    for (auto &group : dups)
+        std::ranges::sort(group.files);
+    std::ranges::sort(dups, std::ranges::greater{}, &DuplicateGroup::wasted_bytes);
+    return dups;
+}
+
+auto hard_link_duplicates(std::span<const DuplicateGroup> groups) noexcept -> DeduplicationReport
+{
+    auto report = DeduplicationReport{};
+    for (const auto &group : groups)
+    {
+        if (group.files.size() < 2)
+            continue;
+
+        const auto &original = group.files.front();
+        const auto content   = common::MappedFile::open(original);
+        if (!content)
+        {
+            report.failures.emplace_back(original, content.error());
+            continue;
+        }
+
+        for (const auto &duplicate : group.files | std::views::drop(1))
+        {
+            auto ec = std::error_code{};
+            if (fs::equivalent(original, duplicate, ec))
+                continue;
+
+            const auto res = replace_with_hard_link(original, content->data(), duplicate);
+            if (!res)
+            {
+                report.failures.emplace_back(duplicate, res.error());
+            }
+            else if (*res)
+            {
+                report.linked_files += 1;
+                report.saved_bytes += group.size;
+            }
+        }
+    }
+    return report;
+}
+} // namespace btu::modmanager
@@ -0,0 +1,195 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/manifest.hpp"
+
+#include "btu/common/filesystem.hpp"
+#include "btu/common/json.hpp"
+
+namespace btu::modmanager {
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(FileState, size, mtime, content_hash, settings_hash)
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ArchiveEntryState, size, content_hash, settings_hash)
+
+namespace {
+/// Bumped whenever the meaning of the stored fields changes, to discard old manifests
+constexpr int k_manifest_version = 1;
+
+[[nodiscard]] auto make_key(const Path &relative_path) noexcept -> std::u8string
+{
+    auto key = relative_path.generic_u8string();
+    common::backslash_to_slash(key);
+    return key;
+}
+
+template<typename Value>
+[[nodiscard]] auto map_to_json(const std::unordered_map<std::u8string, Value> &map) -> nlohmann::json
+{
+    auto j = nlohmann::json::object();
+    for (const auto &[key, value] : map)
+        j[std::string(common::as_ascii(key))] = value;
+    return j;
+}
+
+template<typename Value>
+[[nodiscard]] auto map_from_json(const nlohmann::json &j) -> std::unordered_map<std::u8string, Value>
+{
+    auto map = std::unordered_map<std::u8string, Value>{};
+    for (const auto &[key, value] : j.items())
+        map.emplace(common::as_utf8(key), value.template get<Value>());
+    return map;
+}
+} // namespace
+
+Manifest::Manifest(Path path) noexcept
+    : path_(std::move(path))
+{
+    auto content = common::read_file(path_);
+    if (!content)
+        return;
+
+    const auto j = nlohmann::json::parse(content->begin(), content->end(), nullptr, false);
+    if (j.is_discarded() || j.value("version", 0) != k_manifest_version)
+        return;
+
+    try
+    {
+        auto data = data_.wlock();
+        for (const auto &[archive, entries] : j.at("archives").items())
+            data->archives.emplace(common::as_utf8(archive), map_from_json<ArchiveEntryState>(entries));
+        data->files = map_from_json<FileState>(j.at("files"));
+    }
+    catch (const std::exception &)
+    {
+        // A corrupted manifest only means we will process everything again
+        auto data = data_.wlock();
+        *data     = Data{};
+    }
+}
+
+auto Manifest::save() const noexcept -> tl::expected<void, common::Error>
+{
+    // Held while taking the snapshot too, so that an older snapshot never replaces a newer one
+    const auto lock = std::lock_guard{save_mutex_};
+    try
+    {
+        auto j = nlohmann::json::object();
+        {
+            auto data = data_.rlock();
+            // Modifications need the write lock, so none of them can slip between this and the snapshot
+            dirty_ = false;
+
+            j["version"] = k_manifest_version;
+            j["files"]   = map_to_json(data->files);
+
+            auto archives = nlohmann::json::object();
+            for (const auto &[archive, entries] : data->archives)
+                archives[std::string(common::as_ascii(archive))] = map_to_json(entries);
+            j["archives"] = std::move(archives);
+        }
+
+        const auto str = j.dump();
+
+        // Write next to the target then rename, so that an interrupted save never leaves a truncated manifest
+        const auto tmp_path = temporary_path();
+        const auto res = common::write_file(tmp_path, std::as_bytes(std::span{str.data(), str.size()}));
+        if (!res)
+        {
+            dirty_ = true;
+            return res;
+        }
+
+        auto ec = std::error_code{};
+        fs::rename(tmp_path, path_, ec);
+        if (ec)
+        {
+            dirty_ = true;
+            return tl::make_unexpected(common::Error(ec));
+        }
+        return {};
+    }
+    catch (const std::exception &)
+    {
+        dirty_ = true;
+        return tl::make_unexpected(common::Error(std::make_error_code(std::errc::not_enough_memory)));
+    }
+}
+
+auto Manifest::temporary_path() const -> Path
+{
+    auto tmp_path = path_;
+    tmp_path += ".tmp";
+    return tmp_path;
+}
+
+auto Manifest::file(const Path &relative_path) const noexcept -> std::optional<FileState>
+{
+    auto data = data_.rlock();
+    if (const auto it = data->files.find(make_key(relative_path)); it != data->files.end())
+        return it->second;
+    return std::nullopt;
+}
+
+void Manifest::set_file(const Path &relative_path, FileState state) noexcept
+{
+    auto data                            = data_.wlock();
+    data->files[make_key(relative_path)] = state;
+    dirty_                               = true;
+}
+
+void Manifest::remove_file(const Path &relative_path) noexcept
+{
+    const auto key = make_key(relative_path);
+    auto data      = data_.wlock();
+    data->files.erase(key);
+    data->archives.erase(key);
+    dirty_ = true;
+}
+
+auto Manifest::archive_entry(const Path &archive_relative_path, const Path &entry_path) const noexcept
+    -> std::optional<ArchiveEntryState>
+{
+    auto data = data_.rlock();
+
+    const auto archive = data->archives.find(make_key(archive_relative_path));
+    if (archive == data->archives.end())
+        return std::nullopt;
+
+    if (const auto it = archive->second.find(make_key(entry_path)); it != archive->second.end())
+        return it->second;
+    return std::nullopt;
+}
+
+void Manifest::set_archive(const Path &archive_relative_path,
+                           FileState state,
+                           std::span<const std::pair<Path, ArchiveEntryState>> entries) noexcept
+{
+    auto archive_entries = ArchiveEntries{};
+    for (const auto &[entry_path, entry_state] : entries)
+        archive_entries[make_key(entry_path)] = entry_state;
+
+    const auto key      = make_key(archive_relative_path);
+    auto data           = data_.wlock();
+    data->files[key]    = state;
+    data->archives[key] = std::move(archive_entries);
+    dirty_              = true;
+}
+
+auto Manifest::stat(const Path &absolute_path) noexcept -> std::optional<FileState>
+{
+    auto ec         = std::error_code{};
+    const auto size = fs::file_size(absolute_path, ec);
+    if (ec)
+        return std::nullopt;
+
+    const auto mtime = fs::last_write_time(absolute_path, ec);
+    if (ec)
+        return std::nullopt;
+
+    return FileState{
+        .size  = size,
+        .mtime = static_cast<std::int64_t>(mtime.time_since_epoch().count()),
+    };
+}
+} // namespace btu::modmanager
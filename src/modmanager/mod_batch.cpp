@@ -0,0 +1,87 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/mod_batch.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace btu::modmanager {
+ModBatch::ModBatch(bsa::Settings bsa_settings, bool ignore_existing_archives)
+    : bsa_settings_(BTU_MOV(bsa_settings))
+    , ignore_existing_archives_(ignore_existing_archives)
+    , thread_pool_(common::make_thread_pool())
+    , archive_thread_pool_(common::hardware_concurrency())
+{
+}
+
+auto ModBatch::add_mods_directory(const Path &dir) -> ModManager
+{
+    const auto manager = find_manager(dir);
+    if (manager == ModManager::None)
+    {
+        add_mod(dir);
+        return manager;
+    }
+
+    auto mod_dirs = std::vector<Path>{};
+    for (const auto &entry : fs::directory_iterator(dir))
+    {
+        if (!entry.is_directory())
+            continue;
+
+        // MO2 separators are empty folders used to sort the mod list
+        if (manager == ModManager::MO2 && entry.path().filename().u8string().ends_with(u8"_separator"))
+            continue;
+
+        mod_dirs.emplace_back(entry.path());
+    }
+
+    // Directory iteration order is not guaranteed
+    std::ranges::sort(mod_dirs);
+    for (auto &mod_dir : mod_dirs)
+        add_mod(std::move(mod_dir));
+
+    return manager;
+}
+
+auto ModBatch::add_mod(Path dir) -> ModFolder &
+{
+    auto &mod = mods_.emplace_back(std::move(dir), bsa_settings_, ignore_existing_archives_);
+    mod.use_thread_pool(thread_pool_);
+    mod.use_archive_thread_pool(archive_thread_pool_);
+    mod.use_memory_budget(memory_budget_);
+    return mod;
+}
+
+void ModBatch::transform(const TransformerFactory &make_transformer, const ModDone &on_mod_done) noexcept
+{
+    // Each driver thread feeds the shared pool with the files of one mod at a time. As a mod only waits for
+    // its own files, the next mod is already queued when its last files are running.
+    auto next_mod = std::atomic<size_t>{0};
+    auto drive    = [&] {
+        while (!stop_requested_)
+        {
+            const auto index = next_mod++;
+            if (index >= mods_.size())
+                return;
+
+            auto &mod              = mods_[index];
+            const auto transformer = make_transformer(mod);
+            if (!transformer)
+                continue;
+
+            mod.transform(*transformer);
+            if (on_mod_done)
+                on_mod_done(mod, *transformer);
+        }
+    };
+
+    auto drivers = std::vector<std::jthread>{};
+    for (size_t i = 1; i < std::min(concurrent_mods_, mods_.size()); ++i)
+        drivers.emplace_back(drive);
+    drive();
+}
+} // namespace btu::modmanager
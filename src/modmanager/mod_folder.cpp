@@ -7,79 +7,138 @@
 
 #include "btu/bsa/archive.hpp"
 #include "btu/common/filesystem.hpp"
+#include "btu/common/hash.hpp"
+#include "btu/common/json.hpp"
+#include "btu/modmanager/transform_cache.hpp"
+#include "btu/tex/dxtex.hpp"
+#include "btu/tex/texture.hpp"
 
 #include <binary_io/memory_stream.hpp>
 #include <flux.hpp>
 
+#include <array>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <set>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 
 namespace btu::modmanager {
 
-ModFolder::ModFolder(Path directory, bsa::Settings bsa_settings, bool ignore_existing_archives)
-    : dir_(std::move(directory))
-    , bsa_settings_(BTU_MOV(bsa_settings))
-    , ignore_existing_archives_(ignore_existing_archives)
-    , thread_pool_(common::make_thread_pool())
+FileContent::FileContent(std::function<Result()> load) noexcept
+    : load_(std::move(load))
 {
 }
 
-auto ModFolder::size() noexcept -> size_t
+auto FileContent::from_file(Path absolute_path) noexcept -> FileContent
 {
-    class SizeIterator final : public ModFolderIterator
-    {
-    public:
-        size_t size{};
-
-        [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
-                                             ArchiveTooLargeState /*state*/) noexcept
-            -> ArchiveTooLargeAction override
-        {
-            return Skip;
-        }
+    auto content  = FileContent([absolute_path] { return common::read_file(absolute_path); });
+    content.path_ = std::move(absolute_path);
+    return content;
+}
 
-        void process_file(ModFile /*file*/) noexcept override { size += 1; }
-    };
+auto FileContent::from_bytes(Bytes bytes) noexcept -> FileContent
+{
+    auto content   = FileContent({});
+    content.owned_ = BTU_MOV(bytes);
+    return content;
+}
 
-    auto iterator = SizeIterator{};
-    iterate(iterator);
-    return iterator.size;
+auto FileContent::borrow() const noexcept -> FileContent
+{
+    auto content = FileContent([this]() -> Result {
+        return view().map([](std::span<const std::byte> data) { return Bytes(data.begin(), data.end()); });
+    });
+    content.borrowed_ = this;
+    return content;
 }
 
-void ModFolder::iterate(ModFolderIterator &iterator) noexcept
+auto FileContent::view() const noexcept -> View
 {
-    // creates a ModFolderTransformer based on the user-provided ModFolderIterator
-    class ModFolderProcessorReadOnly final : public ModFolderTransformer
+    if (!owned_ && borrowed_ != nullptr)
+        return borrowed_->view();
+
+    if (!owned_ && !path_.empty())
     {
-    public:
-        explicit ModFolderProcessorReadOnly(ModFolderIterator &iterator) noexcept
-            : iterator_(iterator)
+        if (!mapping_)
         {
+            mapping_ = common::MappedFile::open(path_).map([](common::MappedFile &&file) {
+                return std::make_shared<const common::MappedFile>(BTU_MOV(file));
+            });
         }
+        return mapping_->map([](const auto &file) { return file->data(); });
+    }
 
-        [[nodiscard]] auto archive_too_large(const Path &archive_path, ArchiveTooLargeState state) noexcept
-            -> ArchiveTooLargeAction override
-        {
-            return iterator_.get().archive_too_large(archive_path, state);
-        }
+    return (**this).map([](const Bytes &bytes) { return std::span<const std::byte>(bytes); });
+}
 
-        [[nodiscard]] auto transform_file(ModFile file) noexcept
-            -> std::optional<std::vector<std::byte>> override
+auto FileContent::operator*() const noexcept -> Result &
+{
+    if (!owned_)
+    {
+        if (mapping_ && *mapping_)
         {
-            iterator_.get().process_file(std::move(file));
-            return std::nullopt;
+            const auto data = (*mapping_)->get()->data();
+            owned_          = Bytes(data.begin(), data.end());
         }
-
-        [[nodiscard]] auto stop_requested() const noexcept -> bool override
+        else
         {
-            return iterator_.get().stop_requested();
+            owned_ = load_();
         }
+    }
+    return *owned_;
+}
+
+ModFolder::ModFolder(Path directory, bsa::Settings bsa_settings, bool ignore_existing_archives)
+    : dir_(std::move(directory))
+    , bsa_settings_(BTU_MOV(bsa_settings))
+    , ignore_existing_archives_(ignore_existing_archives)
+{
+}
+
+auto ModFolder::thread_pool() noexcept -> common::ThreadPool &
+{
+    // Called from the tasks of `census` and `iterate` too
+    std::call_once(thread_pool_created_, [this] {
+        if (thread_pool_ != nullptr)
+            return;
+        // The pool can be neither copied nor moved, so make_unique cannot be used
+        own_thread_pool_.reset(new common::ThreadPool(common::make_thread_pool()));
+        thread_pool_ = own_thread_pool_.get();
+    });
+    return *thread_pool_;
+}
 
-    private:
-        std::reference_wrapper<ModFolderIterator> iterator_;
-    } transformer(iterator);
+auto ModFolder::archive_thread_pool() noexcept -> common::ThreadPool &
+{
+    std::call_once(archive_thread_pool_created_, [this] {
+        if (archive_thread_pool_ != nullptr)
+            return;
+        own_archive_thread_pool_.reset(new common::ThreadPool(common::hardware_concurrency()));
+        archive_thread_pool_ = own_archive_thread_pool_.get();
+    });
+    return *archive_thread_pool_;
+}
+
+auto Census::operator+=(const Census &other) -> Census &
+{
+    loose += other.loose;
+    archived += other.archived;
+    archives += other.archives;
+    for (const auto &[extension, stats] : other.extensions)
+        extensions[extension] += stats;
+    unreadable_archives.insert(unreadable_archives.end(),
+                               other.unreadable_archives.begin(),
+                               other.unreadable_archives.end());
+    return *this;
+}
 
-    transform(transformer);
+auto ModFolder::size() noexcept -> size_t
+{
+    return census().files().count;
 }
 
 /**
@@ -114,9 +173,138 @@ void reduce_cpu_usage() noexcept
     std::this_thread::sleep_for(std::chrono::nanoseconds(5));
 }
 
+/// State shared by all the files of a single `transform` run
+struct TransformContext
+{
+    /// Null if incremental processing is disabled
+    Manifest *manifest = nullptr;
+    /// Null if caching is disabled
+    TransformCache *cache = nullptr;
+    std::u8string transformer_id;
+    std::uint64_t settings_hash{};
+    /// Also covers the archive settings, as they change how archives are written
+    std::uint64_t archive_settings_hash{};
+
+    /// Where transformed files of archives are staged until their archive is written.
+    /// Empty if checkpoints are disabled
+    Path resume_dir;
+
+    [[nodiscard]] auto incremental() const noexcept -> bool { return manifest != nullptr; }
+    [[nodiscard]] auto resumable() const noexcept -> bool { return !resume_dir.empty(); }
+
+    /// Context of the calling thread, created on its first file
+    [[nodiscard]] auto worker_context(const ModFolderTransformer &transformer) const noexcept
+        -> WorkerContext *
+    {
+        const auto thread_id = std::this_thread::get_id();
+        if (auto contexts = worker_contexts.rlock(); contexts->contains(thread_id))
+            return contexts->at(thread_id).get();
+
+        // Created outside of the lock, as creating an encoder may be slow.
+        // Only this thread can add its own context, so it cannot have been added in the meantime.
+        auto context = transformer.make_worker_context();
+        return worker_contexts.wlock()->emplace(thread_id, std::move(context)).first->second.get();
+    }
+
+    using WorkerContexts = std::unordered_map<std::thread::id, std::unique_ptr<WorkerContext>>;
+    mutable common::synchronized<WorkerContexts> worker_contexts{};
+
+    /// Staged directories of the archives recorded in the manifest, dropped once the manifest is saved
+    mutable common::synchronized<std::vector<Path>> done_stages{};
+
+    /// Archives written under a new name, which the walk of the folder may find afterwards
+    mutable common::synchronized<std::set<Path>> renamed_archives{};
+};
+
+/**
+ * \brief Calls the transformer, or reuses its output from the cache if the input was already transformed.
+ *
+ * \param content_hash Hash of the content of `file`, if already known.
+ * \param stage Outputs staged by a previous, interrupted run. Null if there is none.
+ */
+[[nodiscard]] auto transform_file(ModFolderTransformer &transformer,
+                                  ModFile file,
+                                  const TransformContext &ctx,
+                                  std::optional<std::uint64_t> content_hash,
+                                  TransformCache *stage = nullptr) noexcept
+    -> std::optional<std::vector<std::byte>>
+{
+    auto call_transformer = [&] {
+        file.worker_context = ctx.worker_context(transformer);
+        return transformer.transform_file(std::move(file));
+    };
+
+    if (ctx.cache == nullptr && stage == nullptr)
+        return call_transformer();
+
+    const auto content = file.content.view();
+    if (!content)
+        return call_transformer();
+
+    const auto key = CacheKey{
+        .input_hash     = content_hash ? *content_hash : common::hash(*content),
+        .input_size     = content->size(),
+        .relative_path  = file.relative_path,
+        .transformer_id = ctx.transformer_id,
+        .settings_hash  = ctx.settings_hash,
+    };
+
+    const auto caches = std::array{stage, ctx.cache};
+    for (auto *cache : caches)
+    {
+        if (cache == nullptr)
+            continue;
+        if (auto cached = cache->find(key))
+            return std::move(cached->content);
+    }
+
+    auto transformed = call_transformer();
+
+    // A stopped transformer may have returned early without transforming the file, but an output is complete
+    if (transformed || !transformer.stop_requested())
+    {
+        using Output      = std::optional<std::span<const std::byte>>;
+        const auto output = transformed ? Output(*transformed) : std::nullopt;
+        for (auto *cache : caches)
+        {
+            if (cache != nullptr)
+                cache->store(key, output);
+        }
+    }
+    return transformed;
+}
+
+/// Suffix of the files written by `write_file_atomically`
+constexpr auto k_temporary_suffix = std::u8string_view(u8".btu-tmp");
+
+/// Writes next to the target then renames, so that an interrupted write never leaves a truncated file
+[[nodiscard]] auto write_file_atomically(const Path &path, std::span<const std::byte> data) noexcept
+    -> tl::expected<void, common::Error>
+{
+    auto tmp_path = path;
+    tmp_path += k_temporary_suffix;
+    if (auto res = common::write_file(tmp_path, data); !res)
+        return res;
+
+    auto ec = std::error_code{};
+    fs::rename(tmp_path, path, ec);
+    if (ec)
+    {
+        fs::remove(tmp_path, ec);
+        return tl::make_unexpected(common::Error(ec));
+    }
+    return {};
+}
+
+[[nodiscard]] auto same_stat(const FileState &lhs, const FileState &rhs) noexcept -> bool
+{
+    return lhs.size == rhs.size && lhs.mtime == rhs.mtime;
+}
+
 void transform_loose_file(const Path &absolute_path,
                           const Path &dir,
-                          ModFolderTransformer &transformer) noexcept
+                          ModFolderTransformer &transformer,
+                          const TransformContext &ctx) noexcept
 {
     if (transformer.stop_requested())
         return;
@@ -125,14 +313,60 @@ void transform_loose_file(const Path &absolute_path,
 
     const auto relative_path = absolute_path.lexically_relative(dir);
 
-    const auto file_data = common::Lazy<tl::expected<std::vector<std::byte>, common::Error>>(
-        [&absolute_path] { return common::read_file(absolute_path); });
+    auto file = ModFile{relative_path, FileContent::from_file(absolute_path)};
 
-    if (const auto transformed = transformer.transform_file(ModFile{relative_path, file_data}))
+    auto state = ctx.incremental() ? Manifest::stat(absolute_path) : std::nullopt;
+    if (state)
     {
-        if (!common::write_file(absolute_path, *transformed))
+        state->settings_hash = ctx.settings_hash;
+
+        const auto previous      = ctx.manifest->file(relative_path);
+        const bool same_settings = previous && previous->settings_hash == state->settings_hash;
+        if (same_settings && same_stat(*previous, *state))
+            return; // Not even read
+
+        if (const auto content = file.content.view())
+        {
+            // The file may have been touched without being modified
+            state->content_hash = common::hash(*content);
+            if (same_settings && previous->content_hash == state->content_hash)
+            {
+                ctx.manifest->set_file(relative_path, *state);
+                return;
+            }
+        }
+        else
+        {
+            state.reset(); // Let the transformer handle the error, but do not remember the file
+        }
+    }
+
+    const auto content_hash = state.transform([](const FileState &s) { return s.content_hash; });
+    if (const auto transformed = transform_file(transformer, std::move(file), ctx, content_hash))
+    {
+        const auto written = ctx.resumable() ? write_file_atomically(absolute_path, *transformed)
+                                             : common::write_file(absolute_path, *transformed);
+        if (!written)
+        {
             transformer.failed_to_write_transformed_file(relative_path, *transformed);
+            return;
+        }
+
+        if (state)
+        {
+            state = Manifest::stat(absolute_path).transform([&](FileState new_state) {
+                new_state.content_hash  = common::hash(*transformed);
+                new_state.settings_hash = ctx.settings_hash;
+                return new_state;
+            });
+        }
     }
+    else if (transformer.stop_requested())
+        return; // A stopped transformer may have returned early without transforming the file
+
+    // A file written after a stop was requested is still recorded, so that it is not transformed again
+    if (state)
+        ctx.manifest->set_file(relative_path, *state);
 }
 
 [[nodiscard]] auto want_to_skip_archive(const Path &archive_path,
@@ -143,40 +377,91 @@ void transform_loose_file(const Path &absolute_path,
            == ModFolderIteratorBase::ArchiveTooLargeAction::Skip;
 }
 
+/// Content of a file stored in an archive, decompressed on first access. `file` must outlive it.
+[[nodiscard]] auto archive_file_content(const bsa::File &file) noexcept -> FileContent
+{
+    return FileContent([&file]() -> FileContent::Result {
+        auto buffer = binary_io::any_ostream{binary_io::memory_ostream{}};
+        if (!file.write(buffer))
+            // TODO: better error here?
+            return tl::make_unexpected(common::Error(std::error_code(errno, std::system_category())));
+
+        // The decompressed buffer is handed over as is
+        return std::move(buffer.get<binary_io::memory_ostream>().rdbuf());
+    });
+}
+
 [[nodiscard]] auto transform_archive_file_inner(ModFolderTransformer &transformer,
                                                 std::atomic_bool &any_file_changed,
-                                                bsa::Archive::value_type &pair) noexcept
+                                                bsa::Archive::value_type &pair,
+                                                const Path &archive_relative_path,
+                                                const TransformContext &ctx,
+                                                TransformCache *stage,
+                                                std::optional<ArchiveEntryState> &entry_state) noexcept
 {
-    return [&transformer, &any_file_changed, &pair] {
+    return [&transformer, &any_file_changed, &pair, &archive_relative_path, &ctx, stage, &entry_state] {
         if (transformer.stop_requested())
             return;
 
         reduce_cpu_usage();
 
         auto &[relative_path, file] = pair;
+        const auto was_compressed   = file.compressed();
 
-        auto file_data = common::Lazy<tl::expected<std::vector<std::byte>, common::Error>>(
-            [&pair]() -> tl::expected<std::vector<std::byte>, common::Error> {
-                auto buffer = binary_io::any_ostream{binary_io::memory_ostream{}};
-                if (!pair.second.write(buffer))
-                    // TODO: better error here?
-                    return tl::make_unexpected(common::Error(std::error_code(errno, std::system_category())));
+        auto mod_file = ModFile{relative_path, archive_file_content(file)};
 
-                return buffer.get<binary_io::memory_ostream>().rdbuf();
-            });
+        if (const auto content = ctx.incremental() ? mod_file.content.view() : FileContent::View{};
+            ctx.incremental() && content)
+        {
+            entry_state = ArchiveEntryState{
+                .size          = content->size(),
+                .content_hash  = common::hash(*content),
+                .settings_hash = ctx.settings_hash,
+            };
 
-        auto transformed = transformer.transform_file(ModFile{relative_path, file_data});
+            if (ctx.manifest->archive_entry(archive_relative_path, relative_path) == entry_state)
+                return;
+        }
+
+        const auto content_hash = entry_state.transform([](const auto &s) { return s.content_hash; });
+        auto transformed        = transform_file(transformer, std::move(mod_file), ctx, content_hash, stage);
         if (transformed)
         {
             const bool res = file.read(*transformed);
             if (!res)
+            {
                 transformer.failed_to_read_transformed_file(relative_path, *transformed);
+                entry_state.reset();
+                return;
+            }
+
+            if (entry_state)
+            {
+                entry_state->size         = transformed->size();
+                entry_state->content_hash = common::hash(*transformed);
+            }
 
-            any_file_changed = any_file_changed || res;
+            // Keep the entry as small as it was, until the archive is written
+            if (was_compressed == bsa::Compression::Yes)
+                std::ignore = file.compress(); // if we fail to compress, we just write uncompressed
+
+            any_file_changed = true;
         }
     };
 }
 
+/// Estimates the peak memory needed to transform a file of an archive: its decompressed content, the
+/// transformed content and its compressed version
+[[nodiscard]] auto estimate_entry_memory_usage(const bsa::File &file) noexcept -> std::uint64_t
+{
+    constexpr std::uint64_t k_compressed_factor   = 6;
+    constexpr std::uint64_t k_uncompressed_factor = 3;
+
+    const auto factor = file.compressed() == bsa::Compression::Yes ? k_compressed_factor
+                                                                   : k_uncompressed_factor;
+    return file.size().value_or(0) * factor;
+}
+
 [[nodiscard]] auto change_archive_version_if_needed(
     bsa::Archive &archive, const bsa::Settings &bsa_settings) noexcept -> tl::expected<bool, common::Error>
 {
@@ -188,11 +473,47 @@ void transform_loose_file(const Path &absolute_path,
     return false;
 }
 
+/// Records the archive and the entries we know the state of, once the archive on disk is final
+void record_archive(const TransformContext &ctx,
+                    const Path &archive_path,
+                    const Path &dir,
+                    std::span<const std::string> entry_names,
+                    std::span<const std::optional<ArchiveEntryState>> entry_states) noexcept
+{
+    auto state = Manifest::stat(archive_path);
+    if (!state)
+        return;
+    state->settings_hash = ctx.archive_settings_hash;
+
+    auto entries = std::vector<std::pair<Path, ArchiveEntryState>>{};
+    entries.reserve(entry_names.size());
+    for (const auto &[name, entry_state] : std::views::zip(entry_names, entry_states))
+    {
+        if (entry_state)
+            entries.emplace_back(name, *entry_state);
+    }
+    ctx.manifest->set_archive(archive_path.lexically_relative(dir), *state, entries);
+}
+
 void transform_archive_file(const Path &archive_path,
+                            const Path &dir,
                             ModFolderTransformer &transformer,
                             const bsa::Settings &bsa_settings,
-                            common::ThreadPool &thread_pool) noexcept
+                            common::ThreadPool &thread_pool,
+                            std::uint64_t window_size,
+                            const TransformContext &ctx) noexcept
 {
+    const auto archive_relative_path = archive_path.lexically_relative(dir);
+    if (ctx.incremental())
+    {
+        // Archives are expensive to read: skip them entirely when they were not modified
+        const auto state    = Manifest::stat(archive_path);
+        const auto previous = ctx.manifest->file(archive_relative_path);
+        if (state && previous && same_stat(*previous, *state)
+            && previous->settings_hash == ctx.archive_settings_hash)
+            return;
+    }
+
     if (const auto arch_size = file_size(archive_path); arch_size > bsa_settings.max_size)
     {
         if (want_to_skip_archive(archive_path,
@@ -208,16 +529,55 @@ void transform_archive_file(const Path &archive_path,
         return;
     }
 
-    auto archive                      = std::move(*opt_arch);
+    auto archive = std::move(*opt_arch);
+
+    auto wanted = [&transformer](const bsa::Archive::value_type &pair) {
+        return transformer.wants_file(pair.first);
+    };
+    if (!std::ranges::any_of(archive, wanted) && !guess_target_archive_version(archive, bsa_settings))
+        return;
+
     std::atomic_bool any_file_changed = false;
-    std::vector<std::future<void>> futs;
-    for (auto &pair : archive)
+    auto entry_states                 = std::vector<std::optional<ArchiveEntryState>>(archive.size());
+
+    // Transformed files are staged until the archive is written, so that an interrupted run can reuse them
+    const auto stage_dir = ctx.resumable() ? ctx.resume_dir / archive_relative_path : Path{};
+    auto stage           = std::optional<TransformCache>{};
+    if (ctx.resumable())
+        stage.emplace(stage_dir, common::MemoryBudget::k_unlimited);
+
+    // Files are transformed through a sliding window: a file is only submitted once the memory needed by
+    // the previous ones fits in the window, otherwise we wait for the oldest one. Transformed files are
+    // compressed again as soon as they are done, so finished files take no more memory than in the original
+    // archive.
+    auto window = common::MemoryBudget{window_size};
+    auto futs   = std::deque<std::future<void>>{};
+    for (auto &&[pair, entry_state] : std::views::zip(archive, entry_states))
     {
         if (transformer.stop_requested())
-            return;
+            break;
 
-        auto fut = thread_pool.submit_task(transform_archive_file_inner(transformer, any_file_changed, pair));
-        futs.push_back(std::move(fut));
+        if (!wanted(pair))
+            continue;
+
+        const auto needed = estimate_entry_memory_usage(pair.second);
+        while (!window.try_acquire(needed))
+        {
+            futs.front().wait();
+            futs.pop_front();
+        }
+
+        auto task = transform_archive_file_inner(transformer,
+                                                 any_file_changed,
+                                                 pair,
+                                                 archive_relative_path,
+                                                 ctx,
+                                                 stage ? &*stage : nullptr,
+                                                 entry_state);
+        futs.push_back(thread_pool.submit_task([task = std::move(task), &window, needed] {
+            task();
+            window.release(needed);
+        }));
     }
     flux::for_each(futs, [](auto &&fut) { fut.wait(); });
     // TODO: there might be an exception in fut. Should we ignore it?
@@ -243,12 +603,21 @@ void transform_archive_file(const Path &archive_path,
     if (transformer.stop_requested())
         return;
 
+    // Writing consumes the archive, but we need its entry names for the manifest
+    auto entry_names = std::vector<std::string>{};
+    if (ctx.incremental())
+        entry_names = flux::from_range(archive).map([](auto &&pair) { return pair.first; }).to<std::vector>();
+
+    auto path = archive_path;
     if (any_file_changed || version_changed.value_or(false))
     {
         // Change the extension of the archive if needed
-        auto path = archive_path;
         if (path.extension() != bsa_settings.extension)
+        {
             path.replace_extension(bsa_settings.extension);
+            // Recorded before the archive exists, so that it is known by the time the walk finds it
+            ctx.renamed_archives.wlock()->insert(path);
+        }
 
         if (!std::move(archive).write(path))
         {
@@ -258,39 +627,412 @@ void transform_archive_file(const Path &archive_path,
 
         // Remove the old archive if the new one has a different name
         if (!equivalent(archive_path, path))
+        {
             fs::remove(archive_path);
+            if (ctx.incremental())
+                ctx.manifest->remove_file(archive_relative_path);
+        }
     }
+
+    if (ctx.incremental())
+        record_archive(ctx, path, dir, entry_names, entry_states);
+
+    // The staged files are only dropped once the manifest on disk knows that the archive is done
+    if (stage)
+        ctx.done_stages.wlock()->push_back(stage_dir);
+}
+
+/**
+ * \brief Estimates the peak memory needed to process the given file.
+ *
+ * Archives are loaded whole, but their files are transformed through a window of `archive_window_size` bytes.
+ * Textures are decoded to uncompressed images, so their header tells much more than their size.
+ */
+[[nodiscard]] auto estimate_memory_usage(const Path &file_path,
+                                         bool is_archive,
+                                         std::uint64_t archive_window_size) noexcept -> std::uint64_t
+{
+    constexpr std::uint64_t k_archive_factor = 3;
+    constexpr std::uint64_t k_file_factor    = 2;
+
+    auto ec               = std::error_code{};
+    const auto disk_size  = static_cast<std::uint64_t>(file_size(file_path, ec));
+    const auto file_bytes = ec ? 0 : disk_size;
+
+    if (is_archive)
+        return std::min(file_bytes * k_archive_factor, file_bytes + archive_window_size);
+
+    const auto ext = common::to_lower(file_path.extension().u8string());
+    if (ext == u8".dds" || ext == u8".tga")
+    {
+        if (const auto tex_bytes = tex::estimate_memory_usage(file_path))
+            return file_bytes + *tex_bytes;
+    }
+    return file_bytes * k_file_factor;
+}
+
+[[nodiscard]] auto is_archive(const Path &file_name) noexcept -> bool
+{
+    const auto ext = common::to_lower(file_name.extension().u8string());
+    return common::contains(bsa::k_archive_extensions, ext);
+}
+
+/// Files of archives being transformed are staged next to the manifest
+[[nodiscard]] auto resume_directory(const Manifest &manifest) noexcept -> Path
+{
+    auto dir = manifest.path();
+    dir += u8".resume";
+    return dir;
+}
+
+/// Saves the manifest if it changed, then drops the staged files of the archives it now records as done
+void checkpoint(const TransformContext &ctx) noexcept
+{
+    // Taken before saving: these archives were recorded before being added, so the save covers them
+    auto done_stages = std::exchange(*ctx.done_stages.wlock(), std::vector<Path>{});
+    if (ctx.manifest->dirty() && !ctx.manifest->save())
+    {
+        // Kept for the next checkpoint
+        auto pending = ctx.done_stages.wlock();
+        pending->insert(pending->end(), done_stages.begin(), done_stages.end());
+        return;
+    }
+
+    for (const auto &stage_dir : done_stages)
+    {
+        auto ec = std::error_code{};
+        fs::remove_all(stage_dir, ec);
+    }
+}
+
+/// Checkpoints every `interval`, until the returned thread is stopped
+[[nodiscard]] auto checkpoint_regularly(const TransformContext &ctx, std::chrono::seconds interval) noexcept
+    -> std::jthread
+{
+    return std::jthread([&ctx, interval](const std::stop_token &stop) {
+        auto mutex = std::mutex{};
+        auto cv    = std::condition_variable_any{};
+        auto lock  = std::unique_lock{mutex};
+        while (!cv.wait_for(lock, stop, interval, [] { return false; }) && !stop.stop_requested())
+            checkpoint(ctx);
+    });
 }
 
 void ModFolder::transform(ModFolderTransformer &transformer) noexcept
 {
-    auto is_arch = [](const Path &file_name) {
-        const auto ext = common::to_lower(file_name.extension().u8string());
-        return common::contains(bsa::k_archive_extensions, ext);
-    };
+    auto ctx = TransformContext{};
+    if (const auto settings_hash = transformer.settings_hash())
+    {
+        ctx.settings_hash = *settings_hash;
+        ctx.archive_settings_hash
+            = common::Hasher{}
+                  .update(*settings_hash)
+                  .update(std::string_view(nlohmann::json(bsa_settings_).dump()))
+                  .digest();
+
+        if (auto id = transformer.id(); id && cache_ != nullptr)
+        {
+            ctx.cache          = cache_;
+            ctx.transformer_id = std::move(*id);
+        }
+    }
+
+    if (manifest_ && transformer.settings_hash())
+    {
+        ctx.manifest = &*manifest_;
+        if (checkpoint_interval_)
+            ctx.resume_dir = resume_directory(*manifest_);
+    }
 
-    auto files = flux::from_range(fs::recursive_directory_iterator(dir_))
-                     .filter([](auto &&e) { return e.is_regular_file(); })
-                     .map([](auto &&e) { return e.path(); })
-                     .to<std::vector>();
+    // The manifest and the staged files may be stored in the folder they describe
+    auto is_manifest = [&](const Path &file_path) {
+        if (!ctx.incremental())
+            return false;
+        const auto &manifest_path = manifest_->path();
+        const auto name           = file_path.filename();
+        if (name != manifest_path.filename() && name != manifest_->temporary_path().filename())
+            return false;
+
+        auto ec = std::error_code{};
+        return fs::equivalent(file_path.parent_path(), manifest_path.parent_path(), ec);
+    };
+    auto staged_prefix = Path{};
+    if (ctx.resumable())
+    {
+        auto ec       = std::error_code{};
+        staged_prefix = fs::relative(ctx.resume_dir, dir_, ec);
+    }
+    auto is_staged = [&](const Path &file_path) {
+        if (staged_prefix.empty())
+            return false;
+        const auto relative_path = file_path.lexically_relative(dir_);
+        return std::ranges::mismatch(staged_prefix, relative_path).in1 == staged_prefix.end();
+    };
+    // Written by this run before being renamed, or left over by an interrupted one
+    auto is_temporary = [](const Path &file_path) {
+        return file_path.filename().u8string().ends_with(k_temporary_suffix);
+    };
 
     std::vector<std::future<void>> futs;
-    for (const auto &file_path : files)
+    auto submit = [&](const Path &file_path, std::uint64_t reserved) {
+        if (is_archive(file_path)) [[unlikely]]
+        {
+            // Archives wait for the tasks of their files, so they are driven from their own pool. On the
+            // pool of the files, archives waiting on every worker would leave no worker to run their files.
+            auto task = [this, &file_path, &transformer, &ctx, reserved] {
+                transform_archive_file(file_path,
+                                       dir_,
+                                       transformer,
+                                       bsa_settings_,
+                                       thread_pool(),
+                                       archive_window_size_,
+                                       ctx);
+                memory_budget_->release(reserved);
+            };
+            futs.push_back(archive_thread_pool().submit_task(std::move(task)));
+            return;
+        }
+
+        futs.push_back(thread_pool().submit_task([this, &file_path, &transformer, &ctx, reserved] {
+            transform_loose_file(file_path, dir_, transformer, ctx);
+            memory_budget_->release(reserved);
+        }));
+    };
+
+    auto checkpointer = ctx.resumable() ? checkpoint_regularly(ctx, *checkpoint_interval_) : std::jthread{};
+
+    // Files are processed while the folder is still being listed. Tasks keep a reference to their path, so
+    // they are stored in a set, which never moves its elements. Tasks also write into the folder: a file
+    // replaced by its task may be listed again, so paths already seen are skipped.
+    auto [walker, paths] = common::walk_files_mt(dir_);
+    auto files           = std::set<Path>{};
+    auto is_renamed      = [&](const Path &file_path) {
+        return ctx.renamed_archives.rlock()->contains(file_path);
+    };
+
+    // Files that did not fit in the memory budget when we first saw them. We keep admitting smaller files
+    // in the meantime, so that cores stay busy while large files wait for memory to be released.
+    auto deferred = std::deque<std::pair<std::reference_wrapper<const Path>, std::uint64_t>>{};
+    for (auto &&path : paths)
     {
         if (transformer.stop_requested())
-            return;
+        {
+            walker.request_stop();
+            break;
+        }
 
-        if (is_arch(file_path) && ignore_existing_archives_)
+        const auto [it, inserted] = files.insert(std::move(path));
+        const auto &file_path     = *it;
+        if (!inserted || is_renamed(file_path))
             continue;
 
-        futs.push_back(thread_pool_.submit_task([this, &file_path, &is_arch, &transformer] {
-            if (is_arch(file_path)) [[unlikely]]
-                transform_archive_file(file_path, transformer, bsa_settings_, thread_pool_);
-            else [[likely]]
-                transform_loose_file(file_path, dir_, transformer);
-        }));
+        if ((is_archive(file_path) && ignore_existing_archives_) || is_manifest(file_path)
+            || is_staged(file_path) || is_temporary(file_path))
+            continue;
+
+        if (!is_archive(file_path) && !transformer.wants_file(file_path.lexically_relative(dir_)))
+            continue;
+
+        while (!deferred.empty() && memory_budget_->try_acquire(deferred.front().second))
+        {
+            submit(deferred.front().first, deferred.front().second);
+            deferred.pop_front();
+        }
+
+        const auto needed = estimate_memory_usage(file_path, is_archive(file_path), archive_window_size_);
+        if (memory_budget_->try_acquire(needed))
+            submit(file_path, needed);
+        else
+            deferred.emplace_back(file_path, needed);
+    }
+
+    for (const auto &[file_path, needed] : deferred)
+    {
+        if (transformer.stop_requested())
+            break;
+
+        memory_budget_->acquire(needed);
+        submit(file_path, needed);
     }
+
+    // Running tasks reference `files`, so we have to wait for them even if a stop was requested
     flux::for_each(futs, [](auto &&fut) { fut.wait(); });
     // TODO: there might be an exception in fut. Should we ignore it?
+
+    checkpointer = {};
+
+    // Failing to save only means the next run will do more work than needed
+    if (ctx.resumable())
+        checkpoint(ctx);
+    else if (ctx.incremental())
+        std::ignore = ctx.manifest->save();
+
+    // Archives that are done already dropped their staged files. The others were not processed, or their
+    // files were not staged with the current settings.
+    if (ctx.resumable() && !transformer.stop_requested())
+    {
+        auto ec = std::error_code{};
+        fs::remove_all(ctx.resume_dir, ec);
+    }
 };
+
+/// Hands the files of an archive to the iterator. The archive is only read, through its memory mapping.
+void iterate_archive_file(const Path &archive_path,
+                          ModFolderIterator &iterator,
+                          const bsa::Settings &bsa_settings,
+                          common::ThreadPool &thread_pool,
+                          std::uint64_t window_size) noexcept
+{
+    if (const auto arch_size = file_size(archive_path); arch_size > bsa_settings.max_size)
+    {
+        using enum ModFolderIteratorBase::ArchiveTooLargeState;
+        using enum ModFolderIteratorBase::ArchiveTooLargeAction;
+        if (iterator.archive_too_large(archive_path, BeforeProcessing) == Skip)
+            return;
+    }
+
+    auto archive = bsa::Archive::read(archive_path);
+    if (!archive)
+    {
+        iterator.failed_to_read_archive(archive_path);
+        return;
+    }
+
+    // Same sliding window as when transforming, so that decompressed files do not pile up
+    auto window = common::MemoryBudget{window_size};
+    auto futs   = std::deque<std::future<void>>{};
+    for (const auto &[relative_path, file] : *archive)
+    {
+        if (iterator.stop_requested())
+            break;
+
+        if (!iterator.wants_file(relative_path))
+            continue;
+
+        const auto needed = estimate_entry_memory_usage(file);
+        while (!window.try_acquire(needed))
+        {
+            futs.front().wait();
+            futs.pop_front();
+        }
+
+        futs.push_back(thread_pool.submit_task([&iterator, &relative_path, &file, &window, needed] {
+            if (!iterator.stop_requested())
+                iterator.process_file(ModFile{relative_path, archive_file_content(file)});
+            window.release(needed);
+        }));
+    }
+    flux::for_each(futs, [](auto &&fut) { fut.wait(); });
+}
+
+void ModFolder::iterate(ModFolderIterator &iterator) noexcept
+{
+    // Unlike `transform`, nothing is ever written: archives are not converted to the target version, and the
+    // folder can be on a read-only mount
+    auto [walker, paths] = common::walk_files_mt(dir_);
+    auto archives        = std::deque<Path>{};
+
+    std::vector<std::future<void>> futs;
+    for (auto &&path : paths)
+    {
+        if (iterator.stop_requested())
+        {
+            walker.request_stop();
+            break;
+        }
+
+        if (is_archive(path))
+        {
+            if (ignore_existing_archives_)
+                continue;
+
+            const auto needed = estimate_memory_usage(path, true, archive_window_size_);
+            memory_budget_->acquire(needed);
+
+            // Driven from their own pool, for the same reason as in `transform`
+            const auto &archive_path = archives.emplace_back(std::move(path));
+            futs.push_back(archive_thread_pool().submit_task([this, &archive_path, &iterator, needed] {
+                iterate_archive_file(archive_path,
+                                     iterator,
+                                     bsa_settings_,
+                                     thread_pool(),
+                                     archive_window_size_);
+                memory_budget_->release(needed);
+            }));
+            continue;
+        }
+
+        auto relative_path = path.lexically_relative(dir_);
+        if (!iterator.wants_file(relative_path))
+            continue;
+
+        const auto needed = estimate_memory_usage(path, false, archive_window_size_);
+        memory_budget_->acquire(needed);
+
+        auto file = ModFile{std::move(relative_path), FileContent::from_file(std::move(path))};
+        futs.push_back(thread_pool().submit_task([this, &iterator, file = std::move(file), needed]() mutable {
+            if (!iterator.stop_requested())
+            {
+                reduce_cpu_usage();
+                iterator.process_file(std::move(file));
+            }
+            memory_budget_->release(needed);
+        }));
+    }
+
+    // Running tasks reference `archives`, so we have to wait for them even if a stop was requested
+    flux::for_each(futs, [](auto &&fut) { fut.wait(); });
+}
+
+/// Counts the files of an archive from its index. Their content is never decompressed.
+[[nodiscard]] auto archive_census(const Path &archive_path, std::uint64_t archive_size) noexcept -> Census
+{
+    auto census     = Census{};
+    census.archives = FileStats{.count = 1, .bytes = archive_size};
+
+    auto archive = bsa::Archive::read(archive_path);
+    if (!archive)
+    {
+        census.unreadable_archives.emplace_back(archive_path);
+        return census;
+    }
+
+    for (const auto &[relative_path, file] : *archive)
+    {
+        const auto stats = FileStats{.count = 1, .bytes = file.size().value_or(0)};
+        census.archived += stats;
+        census.extensions[common::to_lower(Path(relative_path).extension().u8string())] += stats;
+    }
+    return census;
+}
+
+auto ModFolder::census() noexcept -> Census
+{
+    auto result = Census{};
+
+    std::vector<std::future<Census>> futs;
+    for (auto &&path : common::walk_files_mt(dir_).second)
+    {
+        auto ec         = std::error_code{};
+        const auto size = static_cast<std::uint64_t>(fs::file_size(path, ec));
+        if (ec)
+            continue;
+
+        if (is_archive(path))
+        {
+            if (!ignore_existing_archives_)
+                futs.push_back(thread_pool().submit_task(
+                    [path = std::move(path), size] { return archive_census(path, size); }));
+            continue;
+        }
+
+        const auto stats = FileStats{.count = 1, .bytes = size};
+        result.loose += stats;
+        result.extensions[common::to_lower(path.extension().u8string())] += stats;
+    }
+
+    for (auto &fut : futs)
+        result += fut.get();
+    return result;
+}
 } // namespace btu::modmanager
@@ -0,0 +1,186 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/transform_cache.hpp"
+
+#include "btu/common/filesystem.hpp"
+#include "btu/common/hash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+namespace btu::modmanager {
+namespace {
+/// First byte of every cache file
+enum class EntryKind : std::uint8_t
+{
+    Unchanged = 0,
+    Content   = 1,
+};
+
+/// When pruning, we go 10% below the maximum size so that we do not prune again on the next store
+constexpr std::uint64_t k_prune_margin_divisor = 10;
+
+[[nodiscard]] auto to_hex(std::uint64_t value) noexcept -> std::string
+{
+    auto buffer          = std::array<char, 16>{};
+    const auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value, 16);
+    auto str             = std::string(buffer.data(), ptr);
+    str.insert(0, buffer.size() - str.size(), '0');
+    return str;
+}
+
+[[nodiscard]] auto directory_size(const Path &dir) noexcept -> std::uint64_t
+{
+    auto ec      = std::error_code{};
+    auto file_ec = std::error_code{};
+    auto size    = std::uint64_t{0};
+    for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator{};
+         it.increment(ec))
+    {
+        if (it->is_regular_file(file_ec))
+            size += it->file_size(file_ec);
+    }
+    return size;
+}
+} // namespace
+
+TransformCache::TransformCache(Path directory, std::uint64_t max_size) noexcept
+    : dir_(std::move(directory))
+    , max_size_(max_size)
+{
+    auto ec = std::error_code{};
+    fs::create_directories(dir_, ec);
+    size_ = directory_size(dir_);
+}
+
+auto TransformCache::entry_path(const CacheKey &key) const noexcept -> Path
+{
+    auto relative_path = common::to_lower(key.relative_path.generic_u8string());
+    common::backslash_to_slash(relative_path);
+
+    const auto meta_hash = common::Hasher{}
+                               .update(std::u8string_view(key.transformer_id))
+                               .update(key.settings_hash)
+                               .update(std::u8string_view(relative_path))
+                               .digest();
+
+    const auto name = to_hex(key.input_hash) + to_hex(key.input_size) + '-' + to_hex(meta_hash);
+    // Spread entries over subdirectories, file systems do not like huge directories
+    return dir_ / name.substr(0, 2) / name;
+}
+
+auto TransformCache::find(const CacheKey &key) noexcept -> std::optional<CachedOutput>
+{
+    const auto path = entry_path(key);
+    auto data       = common::read_file(path);
+    if (!data || data->empty())
+        return std::nullopt;
+
+    // Mark the entry as recently used
+    auto ec = std::error_code{};
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+    switch (static_cast<EntryKind>(data->front()))
+    {
+        case EntryKind::Unchanged: return CachedOutput{};
+        case EntryKind::Content:
+        {
+            data->erase(data->begin());
+            return CachedOutput{std::move(*data)};
+        }
+    }
+    return std::nullopt; // Corrupted entry, it will be overwritten
+}
+
+void TransformCache::store(const CacheKey &key, std::optional<std::span<const std::byte>> content) noexcept
+{
+    const auto path = entry_path(key);
+
+    auto ec = std::error_code{};
+    if (fs::exists(path, ec))
+        return; // Stored concurrently, maybe by another process
+
+    auto data = std::vector<std::byte>{};
+    data.reserve(1 + (content ? content->size() : 0));
+    data.push_back(static_cast<std::byte>(content ? EntryKind::Content : EntryKind::Unchanged));
+    if (content)
+        data.insert(data.end(), content->begin(), content->end());
+
+    // Write to a unique temporary file then rename, so that readers never see a partial entry
+    fs::create_directories(path.parent_path(), ec);
+    auto tmp_path = path;
+    tmp_path += u8"." + common::str_random(8) + u8".tmp";
+    if (!common::write_file(tmp_path, data))
+    {
+        fs::remove(tmp_path, ec);
+        return;
+    }
+    fs::rename(tmp_path, path, ec);
+    if (ec)
+    {
+        fs::remove(tmp_path, ec);
+        return;
+    }
+
+    if ((size_ += data.size()) > max_size_)
+        prune();
+}
+
+void TransformCache::prune() noexcept
+{
+    // Only one thread prunes at a time, the others can keep working
+    const auto lock = std::unique_lock{prune_mutex_, std::try_to_lock};
+    if (!lock.owns_lock())
+        return;
+
+    struct Entry
+    {
+        Path path;
+        fs::file_time_type last_use;
+        std::uint64_t size;
+    };
+
+    try
+    {
+        auto entries = std::vector<Entry>{};
+        auto total   = std::uint64_t{0};
+        auto ec      = std::error_code{};
+        auto file_ec = std::error_code{};
+        for (auto it = fs::recursive_directory_iterator(dir_, ec);
+             !ec && it != fs::recursive_directory_iterator{};
+             it.increment(ec))
+        {
+            if (!it->is_regular_file(file_ec) || it->path().extension() == ".tmp")
+                continue;
+
+            auto entry = Entry{it->path(), it->last_write_time(file_ec), it->file_size(file_ec)};
+            if (file_ec)
+                continue;
+
+            total += entry.size;
+            entries.emplace_back(std::move(entry));
+        }
+
+        std::ranges::sort(entries, {}, &Entry::last_use);
+
+        const auto target = max_size_ - max_size_ / k_prune_margin_divisor;
+        for (const auto &entry : entries)
+        {
+            if (total <= target)
+                break;
+
+            if (fs::remove(entry.path, file_ec))
+                total -= entry.size;
+        }
+        size_ = total;
+    }
+    catch (const std::exception &)
+    {
+        // Pruning is best effort, we will try again on the next store
+    }
+}
+} // namespace btu::modmanager
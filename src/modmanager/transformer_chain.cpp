@@ -0,0 +1,141 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/transformer_chain.hpp"
+
+#include "btu/common/hash.hpp"
+
+#include <algorithm>
+
+namespace btu::modmanager {
+TransformerChain::TransformerChain(Transformers transformers) noexcept
+    : transformers_(std::move(transformers))
+{
+}
+
+auto TransformerChain::archive_too_large(const Path &archive_path, ArchiveTooLargeState state) noexcept
+    -> ArchiveTooLargeAction
+{
+    // Every transformer must be asked, as some of them report the archive to the user
+    auto action = ArchiveTooLargeAction::Process;
+    for (auto &transformer : transformers_)
+    {
+        if (transformer.get().archive_too_large(archive_path, state) == ArchiveTooLargeAction::Skip)
+            action = ArchiveTooLargeAction::Skip;
+    }
+    return action;
+}
+
+void TransformerChain::failed_to_read_archive(const Path &archive_path) noexcept
+{
+    for (auto &transformer : transformers_)
+        transformer.get().failed_to_read_archive(archive_path);
+}
+
+auto TransformerChain::stop_requested() const noexcept -> bool
+{
+    return std::ranges::any_of(transformers_, [](const auto &t) { return t.get().stop_requested(); });
+}
+
+auto TransformerChain::wants_file(const Path &relative_path) const noexcept -> bool
+{
+    return std::ranges::any_of(transformers_,
+                               [&](const auto &t) { return t.get().wants_file(relative_path); });
+}
+
+auto TransformerChain::transform_file(ModFile file) noexcept -> std::optional<std::vector<std::byte>>
+{
+    const auto *chain_context = file.context<ChainContext>();
+
+    // Each transformer borrows the current content, so nothing is copied unless it asks for an owned buffer
+    auto content = std::move(file.content);
+    bool changed = false;
+    for (size_t i = 0; i < transformers_.size(); ++i)
+    {
+        auto &transformer = transformers_[i].get();
+        if (stop_requested())
+            break;
+
+        if (!transformer.wants_file(file.relative_path))
+            continue;
+
+        auto *context    = chain_context ? chain_context->contexts[i].get() : nullptr;
+        auto transformed = transformer.transform_file(ModFile{file.relative_path, content.borrow(), context});
+        if (!transformed)
+            continue;
+
+        content = FileContent::from_bytes(std::move(*transformed));
+        changed = true;
+    }
+
+    if (!changed)
+        return std::nullopt;
+    return std::move(content->value());
+}
+
+auto TransformerChain::make_worker_context() const noexcept -> std::unique_ptr<WorkerContext>
+{
+    auto context = std::make_unique<ChainContext>();
+    for (const auto &transformer : transformers_)
+        context->contexts.emplace_back(transformer.get().make_worker_context());
+    return context;
+}
+
+void TransformerChain::failed_to_write_transformed_file(const Path &relative_path,
+                                                        std::span<const std::byte> content) noexcept
+{
+    for (auto &transformer : transformers_)
+        transformer.get().failed_to_write_transformed_file(relative_path, content);
+}
+
+void TransformerChain::failed_to_read_transformed_file(const Path &relative_path,
+                                                       std::span<const std::byte> content) noexcept
+{
+    for (auto &transformer : transformers_)
+        transformer.get().failed_to_read_transformed_file(relative_path, content);
+}
+
+void TransformerChain::failed_to_write_archive(const Path &old_archive_path,
+                                               const Path &new_archive_path) noexcept
+{
+    for (auto &transformer : transformers_)
+        transformer.get().failed_to_write_archive(old_archive_path, new_archive_path);
+}
+
+void TransformerChain::failed_to_change_archive_version(const Path &path, const common::Error &error) noexcept
+{
+    for (auto &transformer : transformers_)
+        transformer.get().failed_to_change_archive_version(path, error);
+}
+
+auto TransformerChain::settings_hash() const noexcept -> std::optional<std::uint64_t>
+{
+    auto hasher = common::Hasher{};
+    for (const auto &transformer : transformers_)
+    {
+        const auto hash = transformer.get().settings_hash();
+        if (!hash)
+            return std::nullopt;
+        hasher.update(*hash);
+    }
+    return hasher.digest();
+}
+
+auto TransformerChain::id() const noexcept -> std::optional<std::u8string>
+{
+    auto id = std::u8string{};
+    for (const auto &transformer : transformers_)
+    {
+        const auto transformer_id = transformer.get().id();
+        if (!transformer_id)
+            return std::nullopt;
+
+        if (!id.empty())
+            id += u8'+';
+        id += *transformer_id;
+    }
+    return id;
+}
+} // namespace btu::modmanager
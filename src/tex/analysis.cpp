@@ -0,0 +1,171 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/tex/analysis.hpp"
+
+#include <btu/common/buffer_pool.hpp>
+#include <btu/tex/detail/decompress_bcn.hpp>
+#include <btu/tex/dxtex.hpp>
+#include <btu/tex/texture.hpp>
+
+#include <algorithm>
+
+namespace btu::tex {
+namespace {
+constexpr size_t k_channels = 4;
+/// Rows of compressed images decoded at once. A multiple of the block size.
+constexpr size_t k_strip_rows = 64;
+/// `IsAlphaAllOpaqueBC` counts alpha of at least 0.99 as opaque, while uncompressed formats need 0.997
+constexpr uint8_t k_compressed_opaque_threshold = 253;
+
+/// Accumulates the statistics of rows of 8 bit pixels, in any channel order
+class Scanner
+{
+public:
+    /// Written so that the compiler vectorizes it: only reductions, and no early exit
+    void scan(const uint8_t *pixels, size_t width) noexcept
+    {
+        auto min        = min_;
+        auto max        = max_;
+        uint32_t color  = 0;
+        uint32_t alpha  = 0;
+        const auto size = width * k_channels;
+        for (size_t i = 0; i < size; i += k_channels)
+        {
+            // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            for (size_t c = 0; c < k_channels; ++c)
+            {
+                min[c] = std::min(min[c], pixels[i + c]);
+                max[c] = std::max(max[c], pixels[i + c]);
+            }
+            color |= static_cast<uint32_t>((pixels[i] ^ pixels[i + 1]) | (pixels[i + 1] ^ pixels[i + 2]));
+            // 0 and 255 become 1 and 0, any other alpha is higher
+            alpha |= static_cast<uint8_t>(pixels[i + 3] + 1) > 1 ? 1U : 0U;
+            // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        }
+
+        min_           = min;
+        max_           = max;
+        not_grayscale_ = not_grayscale_ || color != 0;
+        not_binary_    = not_binary_ || alpha != 0;
+    }
+
+    /// \param bgr Whether pixels were stored in BGRA order
+    /// \param opaque Whether the alpha channel is not stored, and thus always 255
+    [[nodiscard]] auto finish(bool bgr, bool opaque) const noexcept -> TextureAnalysis
+    {
+        auto res = TextureAnalysis{
+            .min          = min_,
+            .max          = max_,
+            .binary_alpha = !not_binary_,
+            .grayscale    = !not_grayscale_,
+        };
+        if (bgr)
+        {
+            std::swap(res.min[0], res.min[2]);
+            std::swap(res.max[0], res.max[2]);
+        }
+        if (opaque)
+        {
+            res.min[3]       = 255;
+            res.max[3]       = 255;
+            res.binary_alpha = true;
+        }
+        return res;
+    }
+
+private:
+    std::array<uint8_t, k_channels> min_ = {255, 255, 255, 255};
+    std::array<uint8_t, k_channels> max_ = {0, 0, 0, 0};
+    bool not_grayscale_                  = false;
+    bool not_binary_                     = false;
+};
+
+void scan_image(Scanner &scanner, const Image &image) noexcept
+{
+    for (size_t y = 0; y < image.height; ++y)
+        scanner.scan(image.pixels + y * image.rowPitch, image.width); // NOLINT
+}
+
+void scan_compressed(Scanner &scanner, const Image &image)
+{
+    auto strip_pixels = common::BufferPool<uint8_t>::local().acquire(image.width * k_channels * k_strip_rows);
+    for (size_t begin = 0; begin < image.height; begin += k_strip_rows)
+    {
+        const auto rows = std::min(k_strip_rows, image.height - begin);
+
+        auto strip       = image;
+        strip.height     = rows;
+        strip.pixels     = image.pixels + begin / 4 * image.rowPitch; // NOLINT
+        strip.slicePitch = (rows + 3) / 4 * image.rowPitch;
+
+        const auto decoded = Image{
+            .width      = image.width,
+            .height     = rows,
+            .format     = DXGI_FORMAT_R8G8B8A8_UNORM,
+            .rowPitch   = image.width * k_channels,
+            .slicePitch = image.width * k_channels * rows,
+            .pixels     = strip_pixels.data(),
+        };
+        detail::decompress_bcn({&strip, 1}, {&decoded, 1});
+        scan_image(scanner, decoded);
+    }
+}
+
+[[nodiscard]] auto scan_converted(Scanner &scanner, const Image &image) noexcept -> ResultError
+{
+    ScratchImage converted;
+    const auto hr = DirectX::IsCompressed(image.format)
+                        ? DirectX::Decompress(image, DXGI_FORMAT_R8G8B8A8_UNORM, converted)
+                        : DirectX::Convert(image,
+                                           DXGI_FORMAT_R8G8B8A8_UNORM,
+                                           DirectX::TEX_FILTER_DEFAULT,
+                                           DirectX::TEX_THRESHOLD_DEFAULT,
+                                           converted);
+    if (FAILED(hr))
+        return tl::make_unexpected(error_from_hresult(hr));
+
+    scan_image(scanner, *converted.GetImage(0, 0, 0));
+    return {};
+}
+} // namespace
+
+auto analyze(const Texture &file) noexcept -> tl::expected<TextureAnalysis, Error>
+{
+    const auto format = file.get().GetMetadata().format;
+    const bool bgr    = format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM;
+    const bool opaque = !DirectX::HasAlpha(format);
+
+    try
+    {
+        auto scanner = Scanner{};
+        for (const auto &image : file.get_images())
+        {
+            switch (format)
+            {
+                case DXGI_FORMAT_R8G8B8A8_UNORM:
+                case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+                case DXGI_FORMAT_B8G8R8A8_UNORM:
+                case DXGI_FORMAT_B8G8R8X8_UNORM: scan_image(scanner, image); break;
+                default:
+                {
+                    if (detail::bcn_decoded_format(format))
+                        scan_compressed(scanner, image);
+                    else if (const auto res = scan_converted(scanner, image); !res)
+                        return tl::make_unexpected(res.error());
+                }
+            }
+        }
+        auto res = scanner.finish(bgr, opaque);
+        if (DirectX::IsCompressed(format))
+            res.opaque_threshold = k_compressed_opaque_threshold;
+        return res;
+    }
+    catch (const std::bad_alloc &)
+    {
+        return tl::make_unexpected(error_from_hresult(E_OUTOFMEMORY));
+    }
+}
+} // namespace btu::tex
@@ -63,7 +63,10 @@ auto generate_mipmaps(CrunchTexture &&file) -> ResultCrunch
     return std::move(file);
 }
 
-auto convert(CrunchTexture &&file, const DXGI_FORMAT format) -> ResultCrunch
+auto convert(CrunchTexture &&file,
+             const DXGI_FORMAT format,
+             const EncodingQuality quality,
+             const std::stop_token &stop) -> ResultCrunch
 {
     pixel_format crunch_format{};
     switch (format)
@@ -88,7 +91,22 @@ auto convert(CrunchTexture &&file, const DXGI_FORMAT format) -> ResultCrunch
 
     pack_params.m_perceptual = file.get_texture_type() == TextureType::Diffuse;
 
+    // Crunch defaults to its slowest and best quality level
+    if (quality == EncodingQuality::Fast)
+        pack_params.m_quality = cCRNDXTQualityFast;
+
+    // Crunch reports its progress regularly while packing, and aborts if the callback returns false
+    if (stop.stop_possible())
+    {
+        pack_params.m_pProgress_callback = [](crnlib::uint /*percentage_complete*/, void *user_data) {
+            return !static_cast<const std::stop_token *>(user_data)->stop_requested();
+        };
+        pack_params.m_pProgress_callback_user_data_ptr = const_cast<std::stop_token *>(&stop);
+    }
+
     const auto success = file.get().convert(crunch_format, pack_params);
+    if (stop.stop_requested())
+        return tl::make_unexpected(Error(TextureErr::Cancelled));
     if (!success)
     {
         // No error information is propagated from Crunch.
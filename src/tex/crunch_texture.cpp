@@ -59,6 +59,13 @@ void CrunchTexture::set(const mipmapped_texture &tex) noexcept
     tex_ = tex;
 }
 
+void CrunchTexture::set(mipmapped_texture &&tex) noexcept
+{
+    // crnlib predates move semantics, but can swap the pixel storage of two textures
+    tex_.clear();
+    tex_.swap(tex);
+}
+
 auto CrunchTexture::get() noexcept -> mipmapped_texture &
 {
     return tex_;
@@ -130,7 +137,7 @@ auto load_crunch(Path path) noexcept -> tl::expected<CrunchTexture, Error>
         return tl::make_unexpected(Error(TextureErr::ReadFailure));
     }
 
-    tex.set(mipmapped_tex);
+    tex.set(std::move(mipmapped_tex));
 
     return tex;
 }
@@ -154,7 +161,7 @@ auto load_crunch(Path relative_path,
         return tl::make_unexpected(Error(TextureErr::ReadFailure));
     }
 
-    tex.set(mipmapped_tex);
+    tex.set(std::move(mipmapped_tex));
 
     return tex;
 }
@@ -183,10 +190,10 @@ auto save(const CrunchTexture &tex) noexcept -> tl::expected<std::vector<std::by
     if (!tex.get().write_dds(serializer))
         return tl::make_unexpected(Error(TextureErr::WriteFailure));
 
-    auto buf = out_stream.get_buf();
+    const auto &buf = out_stream.get_buf();
     // NOLINTBEGIN(*pointer-arithmetic): needed for the conversion to work properly
-    return std::vector(reinterpret_cast<std::byte *>(buf.get_ptr()),
-                       reinterpret_cast<std::byte *>(buf.get_ptr() + buf.size_in_bytes()));
+    return std::vector(reinterpret_cast<const std::byte *>(buf.get_ptr()),
+                       reinterpret_cast<const std::byte *>(buf.get_ptr() + buf.size_in_bytes()));
     // NOLINTEND(*pointer-arithmetic)
 }
 } // namespace btu::tex
\ No newline at end of file
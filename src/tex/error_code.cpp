@@ -24,6 +24,7 @@ auto TextureErrCategory::message(int ev) const -> std::string
         case TextureErr::MemoryAllocation: return "memory allocation failure";
         case TextureErr::WriteFailure: return "write failure";
         case TextureErr::ReadFailure: return "read failure";
+        case TextureErr::Cancelled: return "operation cancelled";
         default: return "(unrecognized error)";
     }
 }
@@ -1,9 +1,14 @@
 #include <btu/tex/compression_device.hpp>
+#include <btu/tex/detail/compress_bc7.hpp>
+#include <btu/tex/detail/compress_bcn.hpp>
+#include <btu/tex/detail/decompress_bcn.hpp>
+#include <btu/tex/detail/transcode_bcn.hpp>
 #include <btu/tex/dxtex.hpp>
 #include <btu/tex/error_code.hpp>
 #include <btu/tex/functions.hpp>
 
 #include <algorithm>
+#include <vector>
 
 namespace btu::tex {
 auto decompress(Texture &&file) -> Result
@@ -14,9 +19,21 @@ auto decompress(Texture &&file) -> Result
     const auto &info   = tex.GetMetadata();
 
     ScratchImage timage;
-    const auto hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, timage);
-    if (FAILED(hr))
-        return tl::make_unexpected(error_from_hresult(hr));
+    if (const auto format = detail::bcn_decoded_format(info.format))
+    {
+        auto metadata   = info;
+        metadata.format = *format;
+        if (const auto hr = timage.Initialize(metadata); FAILED(hr))
+            return tl::make_unexpected(error_from_hresult(hr));
+
+        detail::decompress_bcn({img, nimg}, {timage.GetImages(), timage.GetImageCount()});
+    }
+    else
+    {
+        const auto hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, timage);
+        if (FAILED(hr))
+            return tl::make_unexpected(error_from_hresult(hr));
+    }
 
     file.set(std::move(timage));
     return std::move(file);
@@ -54,7 +71,10 @@ auto make_transparent_alpha(Texture &&file) -> Result
 static auto convert_uncompressed(const ScratchImage &image,
                                  ScratchImage &timage,
                                  DXGI_FORMAT format,
-                                 [[maybe_unused]] CompressionDevice &dummy) -> HRESULT
+                                 [[maybe_unused]] CompressionDevice &dummy,
+                                 [[maybe_unused]] EncodingQuality quality,
+                                 [[maybe_unused]] BcEncoder encoder,
+                                 [[maybe_unused]] const std::stop_token &stop) -> HRESULT
 {
     const auto *const img = image.GetImages();
     if (img == nullptr)
@@ -70,16 +90,96 @@ static auto convert_uncompressed(const ScratchImage &image,
                    timage);
 }
 
-// The reason for this to be separated in another file is that both libraries define DXGI_FORMAT
-// So there's a conflict
-// Also, we use another library because DirectXTex BC7 CPU encoder is unbearably slow
-auto convert_bc7(const uint8_t *source, uint8_t *dest, uint32_t width, uint32_t height, size_t slice_pitch)
-    -> tl::expected<void, Error>;
+auto compression_flags(DXGI_FORMAT format, EncodingQuality quality) noexcept -> DirectX::TEX_COMPRESS_FLAGS
+{
+#if _OPENMP
+    auto flags = DirectX::TEX_COMPRESS_PARALLEL;
+#else
+    auto flags = DirectX::TEX_COMPRESS_DEFAULT;
+#endif
+    const bool bc7 = format == DXGI_FORMAT_BC7_UNORM || format == DXGI_FORMAT_BC7_UNORM_SRGB;
+
+    switch (quality)
+    {
+        // BC1-5 have no faster mode
+        case EncodingQuality::Fast:
+            if (bc7)
+                flags = flags | DirectX::TEX_COMPRESS_BC7_QUICK;
+            break;
+        case EncodingQuality::Normal: break;
+        case EncodingQuality::Max:
+            flags = flags | (bc7 ? DirectX::TEX_COMPRESS_BC7_USE_3SUBSETS : DirectX::TEX_COMPRESS_DITHER);
+            break;
+    }
+    return flags;
+}
+
+/// Every mip, face and slice of `source`, to be encoded into `target`
+[[nodiscard]] static auto block_images(const ScratchImage &source, const ScratchImage &target)
+    -> std::vector<detail::BlockImage>
+{
+    auto images = std::vector<detail::BlockImage>{};
+    images.reserve(source.GetImageCount());
+    for (size_t i = 0; i < source.GetImageCount(); ++i)
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const auto &simg = source.GetImages()[i];
+        images.push_back(detail::BlockImage{
+            .pixels    = simg.pixels,
+            .row_pitch = simg.rowPitch,
+            .width     = static_cast<uint32_t>(simg.width),
+            .height    = static_cast<uint32_t>(simg.height),
+            .blocks    = target.GetImages()[i].pixels,
+        });
+        // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    }
+    return images;
+}
+
+static auto convert_builtin(const ScratchImage &image,
+                            ScratchImage &timage,
+                            DXGI_FORMAT format,
+                            detail::BcFormat bc_format,
+                            EncodingQuality quality,
+                            const std::stop_token &stop) -> HRESULT
+{
+    // The encoder reads RGBA8 pixels
+    ScratchImage rgba;
+    const auto *source = &image;
+    const auto info    = image.GetMetadata();
+    if (info.format != DXGI_FORMAT_R8G8B8A8_UNORM && info.format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+    {
+        const auto rgba_format = DirectX::IsSRGB(info.format) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+                                                              : DXGI_FORMAT_R8G8B8A8_UNORM;
+        const auto hr = Convert(image.GetImages(),
+                                image.GetImageCount(),
+                                info,
+                                rgba_format,
+                                DirectX::TEX_FILTER_DEFAULT,
+                                DirectX::TEX_THRESHOLD_DEFAULT,
+                                rgba);
+        if (FAILED(hr))
+            return hr;
+        source = &rgba;
+    }
+
+    auto metadata   = info;
+    metadata.format = format;
+    if (const auto hr = timage.Initialize(metadata); FAILED(hr))
+        return hr;
+
+    if (const auto res = detail::convert_bcn(block_images(*source, timage), bc_format, quality, stop); !res)
+        return res.error() == TextureErr::Cancelled ? E_ABORT : E_FAIL;
+    return S_OK;
+}
 
 static auto convert_compressed(const ScratchImage &image,
                                ScratchImage &timage,
                                DXGI_FORMAT format,
-                               [[maybe_unused]] CompressionDevice &dev) -> HRESULT
+                               [[maybe_unused]] CompressionDevice &dev,
+                               EncodingQuality quality,
+                               BcEncoder encoder,
+                               const std::stop_token &stop) -> HRESULT
 {
     const auto *const img = image.GetImages();
     if (img == nullptr)
@@ -107,7 +207,7 @@ static auto convert_compressed(const ScratchImage &image,
                                nimg,
                                image.GetMetadata(),
                                format,
-                               DirectX::TEX_COMPRESS_DEFAULT,
+                               compression_flags(format, quality),
                                DirectX::TEX_THRESHOLD_DEFAULT,
                                timage);
         });
@@ -123,42 +223,32 @@ static auto convert_compressed(const ScratchImage &image,
         if (FAILED(hr))
             return hr;
 
-        for (size_t i = 0; i < image.GetImageCount(); ++i)
-        {
-            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-            const auto &simg = image.GetImages()[i];
-            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-            const auto &timg = timage.GetImages()[i];
-
-            const auto res = convert_bc7(simg.pixels,
-                                         timg.pixels,
-                                         static_cast<uint32_t>(simg.width),
-                                         static_cast<uint32_t>(simg.height),
-                                         simg.slicePitch);
-            if (!res)
-                return E_FAIL;
-        }
+        // All mips, faces and slices are given at once, so that small ones are encoded concurrently
+        if (const auto res = detail::convert_bc7(block_images(image, timage), quality, stop); !res)
+            return res.error() == TextureErr::Cancelled ? E_ABORT : E_FAIL;
         return S_OK;
     }
 
-    constexpr auto compress_flags = [] {
-#if _OPENMP
-        return DirectX::TEX_COMPRESS_PARALLEL;
-#else
-        return DirectX::TEX_COMPRESS_DEFAULT;
-#endif
-    }();
+    if (const auto bc_format = detail::to_bc_format(format); bc_format && encoder == BcEncoder::Builtin)
+        return convert_builtin(image, timage, format, *bc_format, quality, stop);
 
+    // DirectXTex only compresses into a texture of its own, so the whole texture is given at once: splitting
+    // it would mean copying every image. It cannot be interrupted once started, unlike the builtin encoder.
     return Compress(img,
                     nimg,
                     image.GetMetadata(),
                     format,
-                    compress_flags,
+                    compression_flags(format, quality),
                     DirectX::TEX_THRESHOLD_DEFAULT,
                     timage);
 }
 
-auto convert(Texture &&file, DXGI_FORMAT format, CompressionDevice &dev) -> Result
+auto convert(Texture &&file,
+             DXGI_FORMAT format,
+             CompressionDevice &dev,
+             EncodingQuality quality,
+             BcEncoder encoder,
+             const std::stop_token &stop) -> Result
 {
     const auto &tex = file.get();
     const auto info = tex.GetMetadata();
@@ -168,12 +258,20 @@ auto convert(Texture &&file, DXGI_FORMAT format, CompressionDevice &dev) -> Resu
     if (uncompressed_required && DirectX::IsCompressed(info.format))
         return tl::make_unexpected(Error(TextureErr::BadInput));
 
+    // The GPU encoder and uncompressed conversions cannot be interrupted, but need not start at all
+    if (stop.stop_requested())
+        return tl::make_unexpected(Error(TextureErr::Cancelled));
+
     ScratchImage timage;
 
     const auto f = DirectX::IsCompressed(format) ? convert_compressed : convert_uncompressed;
 
-    if (const auto hr = f(tex, timage, format, dev); FAILED(hr))
+    if (const auto hr = f(tex, timage, format, dev, quality, encoder, stop); FAILED(hr))
+    {
+        if (hr == E_ABORT)
+            return tl::make_unexpected(Error(TextureErr::Cancelled));
         return tl::make_unexpected(error_from_hresult(hr));
+    }
 
     file.set(std::move(timage));
     return std::move(file);
@@ -184,6 +282,10 @@ static auto prepare_generate_mipmaps(Texture &&file) -> Result
     const auto &tex = file.get();
     // Mips generation only works on a single base image, so strip off existing mip levels
     const auto &info = tex.GetMetadata();
+    // Nothing to strip: avoid a copy of the whole texture
+    if (info.mipLevels == 1)
+        return std::move(file);
+
     ScratchImage timage;
 
     TexMetadata mdata = info;
@@ -251,4 +353,89 @@ auto resize(Texture &&file, Dimension dim) -> Result
     file.set(std::move(timage));
     return std::move(file);
 }
+
+auto can_transcode(const Texture &file, DXGI_FORMAT format) noexcept -> bool
+{
+    const auto transcoding = detail::find_transcoding(file.get().GetMetadata().format, format);
+    return transcoding && std::ranges::all_of(file.get_images(), [&](const Image &image) {
+               return detail::can_transcode_blocks(*transcoding, image);
+           });
+}
+
+auto transcode(Texture &&file, DXGI_FORMAT format) -> Result
+{
+    if (!can_transcode(file, format))
+        return tl::make_unexpected(Error(TextureErr::BadInput));
+
+    const auto &tex        = file.get();
+    const auto transcoding = *detail::find_transcoding(tex.GetMetadata().format, format);
+
+    auto metadata   = tex.GetMetadata();
+    metadata.format = format;
+
+    ScratchImage timage;
+    if (const auto hr = timage.Initialize(metadata); FAILED(hr))
+        return tl::make_unexpected(error_from_hresult(hr));
+
+    const auto sources = file.get_images();
+    const auto targets = std::span(timage.GetImages(), timage.GetImageCount());
+    for (size_t i = 0; i < sources.size(); ++i)
+        detail::transcode_blocks(transcoding, sources[i], targets[i]);
+
+    file.set(std::move(timage));
+    return std::move(file);
+}
+
+auto droppable_mips(const TexMetadata &info, Dimension target) noexcept -> std::optional<size_t>
+{
+    const auto source = Dimension{.w = info.width, .h = info.height};
+    if (info.dimension == DirectX::TEX_DIMENSION_TEXTURE3D || info.mipLevels != optimal_mip_count(source))
+        return std::nullopt;
+
+    for (size_t count = 1; count < info.mipLevels; ++count)
+    {
+        const auto mip = Dimension{.w = std::max<size_t>(1, source.w >> count),
+                                   .h = std::max<size_t>(1, source.h >> count)};
+        if (mip == target)
+            return count;
+    }
+    return std::nullopt;
+}
+
+auto drop_mips(Texture &&file, size_t count) -> Result
+{
+    const auto &tex = file.get();
+    auto metadata   = tex.GetMetadata();
+    if (count == 0 || count >= metadata.mipLevels || metadata.dimension == DirectX::TEX_DIMENSION_TEXTURE3D)
+        return tl::make_unexpected(Error(TextureErr::BadInput));
+
+    metadata.width     = std::max<size_t>(1, metadata.width >> count);
+    metadata.height    = std::max<size_t>(1, metadata.height >> count);
+    metadata.mipLevels = metadata.mipLevels - count;
+
+    ScratchImage timage;
+    if (const auto hr = timage.Initialize(metadata); FAILED(hr))
+        return tl::make_unexpected(error_from_hresult(hr));
+
+    for (size_t item = 0; item < metadata.arraySize; ++item)
+    {
+        for (size_t mip = 0; mip < metadata.mipLevels; ++mip)
+        {
+            const auto *src = tex.GetImage(mip + count, item, 0);
+            const auto *dst = timage.GetImage(mip, item, 0);
+
+            // Pitches may differ if the source was loaded with legacy pitch flags
+            const auto row_size = std::min(src->rowPitch, dst->rowPitch);
+            const auto rows     = DirectX::ComputeScanlines(metadata.format, dst->height);
+            for (size_t row = 0; row < rows; ++row)
+            {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                std::copy_n(src->pixels + row * src->rowPitch, row_size, dst->pixels + row * dst->rowPitch);
+            }
+        }
+    }
+
+    file.set(std::move(timage));
+    return std::move(file);
+}
 } // namespace btu::tex
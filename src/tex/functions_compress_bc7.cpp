@@ -1,41 +1,135 @@
-#if _OPENMP
-#include <omp.h>
-#endif
 #include <bc7enc/rdo_bc_encoder.h>
 #include <bc7enc/utils.h>
+#include <btu/tex/detail/compress_bc7.hpp>
+#include <btu/tex/detail/parallel.hpp>
 #include <btu/tex/error_code.hpp>
 #include <tl/expected.hpp>
 
-namespace btu::tex {
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stop_token>
+#include <vector>
 
-auto convert_bc7(const uint8_t *source, uint8_t *dest, uint32_t width, uint32_t height, size_t slice_pitch)
-    -> tl::expected<void, Error>
+namespace btu::tex::detail {
+/// Pixel rows encoded at once. A multiple of the block size, so that strips can be encoded separately.
+constexpr uint32_t k_strip_height = 256;
+/// Images with fewer blocks cannot keep every core busy on their own
+constexpr size_t k_min_parallel_blocks = size_t{64} * 64;
+constexpr size_t k_block_size          = 16;
+/// Partitions tried by the fast preset, out of 64
+constexpr uint32_t k_fast_partitions = 16;
+
+[[nodiscard]] static auto make_params(bool multithreaded, EncodingQuality quality) noexcept
+    -> rdo_bc::rdo_bc_params
 {
     rdo_bc::rdo_bc_params rp;
 
     rp.m_rdo_max_threads = 1;
-#if _OPENMP
+
     constexpr int min_threads = 128; // no idea why, comes from the original code
-    rp.m_rdo_max_threads      = std::min(std::max(1, omp_get_max_threads()), min_threads);
-#endif
+    if (multithreaded)
+        rp.m_rdo_max_threads = std::min(std::max(1, omp_thread_count()), min_threads);
+
     rp.m_bc7enc_reduce_entropy = true;
 
-    rdo_bc::rdo_bc_encoder encoder;
+    switch (quality)
+    {
+        case EncodingQuality::Fast:
+            rp.m_bc7_uber_level                = 0;
+            rp.m_bc7enc_max_partitions_to_scan = k_fast_partitions;
+            break;
+        case EncodingQuality::Normal: break;
+        case EncodingQuality::Max:
+            rp.m_bc7_uber_level                = BC7ENC_MAX_UBER_LEVEL;
+            rp.m_bc7enc_max_partitions_to_scan = BC7ENC_MAX_PARTITIONS;
+            break;
+    }
+    return rp;
+}
+
+/// Encodes rows [y, y + height) of `image`
+[[nodiscard]] static auto encode_strip(const BlockImage &image,
+                                       uint32_t y,
+                                       uint32_t height,
+                                       const rdo_bc::rdo_bc_params &rp) -> bool
+{
+    // Kept per thread, so that their memory is reused from one strip or image to the next
+    thread_local rdo_bc::rdo_bc_encoder encoder;
+    thread_local utils::image_u8 pixels;
 
-    utils::image_u8 image(width, height);
-    memcpy(image.get_pixels().data(), source, slice_pitch);
+    const auto row_size = size_t{image.width} * 4;
+    pixels.init(image.width, height);
+    for (uint32_t row = 0; row < height; ++row)
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        memcpy(reinterpret_cast<uint8_t *>(pixels.get_pixels().data()) + row * row_size,
+               image.pixels + (y + row) * image.row_pitch,
+               row_size);
+        // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    }
 
-    if (!encoder.init(image, rp))
-        return tl::make_unexpected(Error(TextureErr::Unknown));
+    if (!encoder.init(pixels, rp) || !encoder.encode())
+        return false;
 
-    if (!encoder.encode())
-        return tl::make_unexpected(Error(TextureErr::Unknown));
+    const auto block_row_size = (image.width + 3) / 4 * k_block_size;
+    const auto *res_blocks    = static_cast<const uint8_t *>(encoder.get_blocks());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    std::copy_n(res_blocks, encoder.get_total_blocks_size_in_bytes(), image.blocks + y / 4 * block_row_size);
+    return true;
+}
 
-    const auto *res_blocks = static_cast<const uint8_t *>(encoder.get_blocks());
-    slice_pitch            = encoder.get_total_blocks_size_in_bytes();
+[[nodiscard]] static auto block_count(const BlockImage &image) noexcept -> size_t
+{
+    return size_t{(image.width + 3) / 4} * ((image.height + 3) / 4);
+}
+
+auto convert_bc7(std::span<const BlockImage> images, EncodingQuality quality, const std::stop_token &stop)
+    -> tl::expected<void, Error>
+{
+    const auto multithreaded = make_params(true, quality);
+    auto small               = std::vector<const BlockImage *>{};
 
-    std::copy_n(res_blocks, slice_pitch, dest);
+    for (const auto &image : images)
+    {
+        // A single image has nothing to be encoded alongside
+        if (block_count(image) < k_min_parallel_blocks && images.size() > 1)
+        {
+            small.push_back(&image);
+            continue;
+        }
 
+        // Blocks are encoded independently, so encoding the image by strips of block rows gives the same
+        // result, while letting a stop request interrupt a large texture
+        for (uint32_t y = 0; y < image.height; y += k_strip_height)
+        {
+            if (stop.stop_requested())
+                return tl::make_unexpected(Error(TextureErr::Cancelled));
+
+            if (!encode_strip(image, y, std::min(k_strip_height, image.height - y), multithreaded))
+                return tl::make_unexpected(Error(TextureErr::Unknown));
+        }
+    }
+
+    // Each small image is encoded on a single core, and all of them at once
+    const auto single_threaded = make_params(false, quality);
+    auto failed                = std::atomic<bool>{false};
+    const auto count           = static_cast<int64_t>(small.size());
+#pragma omp parallel for schedule(dynamic) num_threads(omp_thread_count())
+    for (int64_t i = 0; i < count; ++i)
+    {
+        if (failed.load(std::memory_order_relaxed) || stop.stop_requested())
+            continue;
+
+        const auto &image = *small[static_cast<size_t>(i)];
+        if (!encode_strip(image, 0, image.height, single_threaded))
+            failed.store(true, std::memory_order_relaxed);
+    }
+
+    if (stop.stop_requested())
+        return tl::make_unexpected(Error(TextureErr::Cancelled));
+    if (failed.load())
+        return tl::make_unexpected(Error(TextureErr::Unknown));
     return {};
 }
-} // namespace btu::tex
\ No newline at end of file
+} // namespace btu::tex::detail
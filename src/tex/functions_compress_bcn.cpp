@@ -0,0 +1,762 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <btu/tex/detail/compress_bcn.hpp>
+#include <btu/tex/detail/parallel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// Loops over the pixels of a block work on fixed size arrays, one per channel, without branches, so that the
+// compiler vectorizes them for the instruction set the library is built for.
+// Searching the closest palette entry of each pixel is where most of the time goes: it also has SSE4.1 and
+// AVX2 versions, picked at runtime from the CPU.
+namespace btu::tex::detail {
+constexpr size_t k_pixels = 16;
+
+using Channel = std::array<float, k_pixels>;
+using Rgb     = std::array<float, 3>;
+using Indices = std::array<uint8_t, k_pixels>;
+
+/// Same perceptual weights as DirectXTex, relative to green
+constexpr auto k_weights = Rgb{0.2125F / 0.7154F, 1.F, 0.0721F / 0.7154F};
+
+struct Block
+{
+    std::array<Channel, 4> channels;
+};
+
+[[nodiscard]] static auto load_block(const BlockImage &image, uint32_t block_x, uint32_t block_y) noexcept
+    -> Block
+{
+    auto block = Block{};
+    for (uint32_t py = 0; py < 4; ++py)
+    {
+        // Blocks on the edges of images whose size is not a multiple of 4 repeat their last row and column
+        const auto y = std::min(block_y * 4 + py, image.height - 1);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const auto *row = image.pixels + y * image.row_pitch;
+        for (uint32_t px = 0; px < 4; ++px)
+        {
+            const auto x = std::min(block_x * 4 + px, image.width - 1);
+            for (size_t ch = 0; ch < 4; ++ch)
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                block.channels[ch][py * 4 + px] = row[x * 4 + ch];
+        }
+    }
+    return block;
+}
+
+[[nodiscard]] static auto to_565(const Rgb &color) noexcept -> uint16_t
+{
+    const auto quantize = [](float value, float max) {
+        return static_cast<uint32_t>(std::lround(std::clamp(value, 0.F, 255.F) * max / 255.F));
+    };
+    return static_cast<uint16_t>(quantize(color[0], 31.F) << 11 | quantize(color[1], 63.F) << 5
+                                 | quantize(color[2], 31.F));
+}
+
+[[nodiscard]] static auto from_565(uint16_t color) noexcept -> Rgb
+{
+    const auto r = (color >> 11) & 31U;
+    const auto g = (color >> 5) & 63U;
+    const auto b = color & 31U;
+    return {static_cast<float>(r << 3 | r >> 2),
+            static_cast<float>(g << 2 | g >> 4),
+            static_cast<float>(b << 3 | b >> 2)};
+}
+
+using ColorPalette  = std::array<Rgb, 4>;
+using SinglePalette = std::array<float, 8>;
+
+/**
+ * \brief Finds the closest palette entry of each pixel, using the perceptual weights.
+ *
+ * All versions give the same result: they compute the distances in the same order, and keep the first
+ * closest entry.
+ * \param count Number of entries of `palette` to consider
+ */
+static void nearest_colors_scalar(const Block &block,
+                                  const ColorPalette &palette,
+                                  uint8_t count,
+                                  Channel &best,
+                                  Indices &indices) noexcept
+{
+    best.fill(std::numeric_limits<float>::max());
+    indices.fill(0);
+    for (uint8_t p = 0; p < count; ++p)
+    {
+        const auto &color = palette[p];
+        for (size_t i = 0; i < k_pixels; ++i)
+        {
+            const auto dr   = block.channels[0][i] - color[0];
+            const auto dg   = block.channels[1][i] - color[1];
+            const auto db   = block.channels[2][i] - color[2];
+            const auto dist = k_weights[0] * dr * dr + k_weights[1] * dg * dg + k_weights[2] * db * db;
+            indices[i]      = dist < best[i] ? p : indices[i];
+            best[i]         = std::min(dist, best[i]);
+        }
+    }
+}
+
+/// Finds the closest palette entry of each value
+static void nearest_values_scalar(const Channel &values,
+                                  const SinglePalette &palette,
+                                  Channel &best,
+                                  Indices &indices) noexcept
+{
+    best.fill(std::numeric_limits<float>::max());
+    indices.fill(0);
+    for (uint8_t p = 0; p < palette.size(); ++p)
+    {
+        for (size_t i = 0; i < k_pixels; ++i)
+        {
+            const auto dist = (values[i] - palette[p]) * (values[i] - palette[p]);
+            indices[i]      = dist < best[i] ? p : indices[i];
+            best[i]         = std::min(dist, best[i]);
+        }
+    }
+}
+
+#if BTU_BCN_X86
+/// Indices are tracked as floats alongside the distances, then narrowed to bytes
+BTU_BCN_TARGET("sse4.1")
+static void store_indices_sse41(__m128 indices, uint8_t *out) noexcept
+{
+    const auto words = _mm_packus_epi32(_mm_cvttps_epi32(indices), _mm_setzero_si128());
+    const auto bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, _mm_setzero_si128()));
+    std::memcpy(out, &bytes, 4);
+}
+
+BTU_BCN_TARGET("sse4.1")
+static void nearest_colors_sse41(const Block &block,
+                                 const ColorPalette &palette,
+                                 uint8_t count,
+                                 Channel &best,
+                                 Indices &indices) noexcept
+{
+    const auto kr = _mm_set1_ps(k_weights[0]);
+    const auto kg = _mm_set1_ps(k_weights[1]);
+    const auto kb = _mm_set1_ps(k_weights[2]);
+    for (size_t i = 0; i < k_pixels; i += 4)
+    {
+        const auto r = _mm_loadu_ps(&block.channels[0][i]);
+        const auto g = _mm_loadu_ps(&block.channels[1][i]);
+        const auto b = _mm_loadu_ps(&block.channels[2][i]);
+
+        auto closest = _mm_set1_ps(std::numeric_limits<float>::max());
+        auto index   = _mm_setzero_ps();
+        for (uint8_t p = 0; p < count; ++p)
+        {
+            const auto dr   = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+            const auto dg   = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+            const auto db   = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+            const auto dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(kr, dr), dr),
+                                                    _mm_mul_ps(_mm_mul_ps(kg, dg), dg)),
+                                         _mm_mul_ps(_mm_mul_ps(kb, db), db));
+            index   = _mm_blendv_ps(index, _mm_set1_ps(p), _mm_cmplt_ps(dist, closest));
+            closest = _mm_min_ps(dist, closest);
+        }
+        _mm_storeu_ps(&best[i], closest);
+        store_indices_sse41(index, &indices[i]);
+    }
+}
+
+BTU_BCN_TARGET("sse4.1")
+static void nearest_values_sse41(const Channel &values,
+                                 const SinglePalette &palette,
+                                 Channel &best,
+                                 Indices &indices) noexcept
+{
+    for (size_t i = 0; i < k_pixels; i += 4)
+    {
+        const auto v = _mm_loadu_ps(&values[i]);
+
+        auto closest = _mm_set1_ps(std::numeric_limits<float>::max());
+        auto index   = _mm_setzero_ps();
+        for (uint8_t p = 0; p < palette.size(); ++p)
+        {
+            const auto diff = _mm_sub_ps(v, _mm_set1_ps(palette[p]));
+            const auto dist = _mm_mul_ps(diff, diff);
+            index           = _mm_blendv_ps(index, _mm_set1_ps(p), _mm_cmplt_ps(dist, closest));
+            closest         = _mm_min_ps(dist, closest);
+        }
+        _mm_storeu_ps(&best[i], closest);
+        store_indices_sse41(index, &indices[i]);
+    }
+}
+
+BTU_BCN_TARGET("avx2")
+static void store_indices_avx2(__m256 indices, uint8_t *out) noexcept
+{
+    const auto dwords = _mm256_cvttps_epi32(indices);
+    const auto words  = _mm_packus_epi32(_mm256_castsi256_si128(dwords), _mm256_extracti128_si256(dwords, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(words, _mm_setzero_si128()));
+}
+
+BTU_BCN_TARGET("avx2")
+static void nearest_colors_avx2(const Block &block,
+                                const ColorPalette &palette,
+                                uint8_t count,
+                                Channel &best,
+                                Indices &indices) noexcept
+{
+    const auto kr = _mm256_set1_ps(k_weights[0]);
+    const auto kg = _mm256_set1_ps(k_weights[1]);
+    const auto kb = _mm256_set1_ps(k_weights[2]);
+    for (size_t i = 0; i < k_pixels; i += 8)
+    {
+        const auto r = _mm256_loadu_ps(&block.channels[0][i]);
+        const auto g = _mm256_loadu_ps(&block.channels[1][i]);
+        const auto b = _mm256_loadu_ps(&block.channels[2][i]);
+
+        auto closest = _mm256_set1_ps(std::numeric_limits<float>::max());
+        auto index   = _mm256_setzero_ps();
+        for (uint8_t p = 0; p < count; ++p)
+        {
+            const auto dr   = _mm256_sub_ps(r, _mm256_set1_ps(palette[p][0]));
+            const auto dg   = _mm256_sub_ps(g, _mm256_set1_ps(palette[p][1]));
+            const auto db   = _mm256_sub_ps(b, _mm256_set1_ps(palette[p][2]));
+            const auto dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(kr, dr), dr),
+                                                          _mm256_mul_ps(_mm256_mul_ps(kg, dg), dg)),
+                                            _mm256_mul_ps(_mm256_mul_ps(kb, db), db));
+            const auto closer = _mm256_cmp_ps(dist, closest, _CMP_LT_OQ);
+            index             = _mm256_blendv_ps(index, _mm256_set1_ps(p), closer);
+            closest           = _mm256_min_ps(dist, closest);
+        }
+        _mm256_storeu_ps(&best[i], closest);
+        store_indices_avx2(index, &indices[i]);
+    }
+}
+
+BTU_BCN_TARGET("avx2")
+static void nearest_values_avx2(const Channel &values,
+                                const SinglePalette &palette,
+                                Channel &best,
+                                Indices &indices) noexcept
+{
+    for (size_t i = 0; i < k_pixels; i += 8)
+    {
+        const auto v = _mm256_loadu_ps(&values[i]);
+
+        auto closest = _mm256_set1_ps(std::numeric_limits<float>::max());
+        auto index   = _mm256_setzero_ps();
+        for (uint8_t p = 0; p < palette.size(); ++p)
+        {
+            const auto diff   = _mm256_sub_ps(v, _mm256_set1_ps(palette[p]));
+            const auto dist   = _mm256_mul_ps(diff, diff);
+            const auto closer = _mm256_cmp_ps(dist, closest, _CMP_LT_OQ);
+            index             = _mm256_blendv_ps(index, _mm256_set1_ps(p), closer);
+            closest           = _mm256_min_ps(dist, closest);
+        }
+        _mm256_storeu_ps(&best[i], closest);
+        store_indices_avx2(index, &indices[i]);
+    }
+}
+#endif
+
+struct Kernels
+{
+    decltype(&nearest_colors_scalar) nearest_colors;
+    decltype(&nearest_values_scalar) nearest_values;
+};
+
+[[nodiscard]] static auto kernels(InstructionSet isa) noexcept -> Kernels
+{
+    switch (std::min(isa, best_instruction_set()))
+    {
+#if BTU_BCN_X86
+        case InstructionSet::Avx2: return {nearest_colors_avx2, nearest_values_avx2};
+        case InstructionSet::Sse41: return {nearest_colors_sse41, nearest_values_sse41};
+#endif
+        default: return {nearest_colors_scalar, nearest_values_scalar};
+    }
+}
+
+auto best_instruction_set() noexcept -> InstructionSet
+{
+#if BTU_BCN_X86
+    static const auto isa = [] {
+#ifdef _MSC_VER
+        auto info = std::array<int, 4>{};
+        __cpuid(info.data(), 0);
+        const auto max_leaf = info[0];
+        __cpuid(info.data(), 1);
+        const bool sse41 = (info[2] & (1 << 19)) != 0;
+        // AVX registers also need to be saved by the OS
+        const bool os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0
+                            && (_xgetbv(0) & 6) == 6;
+        auto avx2 = false;
+        if (max_leaf >= 7)
+        {
+            __cpuidex(info.data(), 7, 0);
+            avx2 = os_avx && (info[1] & (1 << 5)) != 0;
+        }
+#else
+        __builtin_cpu_init();
+        const bool sse41 = __builtin_cpu_supports("sse4.1") != 0;
+        const bool avx2  = __builtin_cpu_supports("avx2") != 0;
+#endif
+        if (avx2)
+            return InstructionSet::Avx2;
+        return sse41 ? InstructionSet::Sse41 : InstructionSet::Scalar;
+    }();
+    return isa;
+#else
+    return InstructionSet::Scalar;
+#endif
+}
+
+/// Weight of the first endpoint for each index, in the four colors and three colors modes
+constexpr auto k_four_colors_weights  = std::array{1.F, 0.F, 2.F / 3.F, 1.F / 3.F};
+constexpr auto k_three_colors_weights = std::array{1.F, 0.F, 1.F / 2.F, 0.F};
+
+struct ColorFit
+{
+    uint16_t c0;
+    uint16_t c1;
+    Indices indices;
+    float error;
+};
+
+/**
+ * \brief Picks the closest palette entry for each pixel.
+ * \param opaque 1 for pixels to encode, 0 for transparent ones, which are given index 3.
+ */
+[[nodiscard]] static auto fit_colors(const Kernels &kernels,
+                                     const Block &block,
+                                     const Channel &opaque,
+                                     uint16_t c0,
+                                     uint16_t c1,
+                                     bool three_colors) noexcept -> ColorFit
+{
+    // The mode is chosen by the order of the endpoints
+    if (three_colors ? c0 > c1 : c0 < c1)
+        std::swap(c0, c1);
+
+    const auto first   = from_565(c0);
+    const auto second  = from_565(c1);
+    const auto &weight = three_colors ? k_three_colors_weights : k_four_colors_weights;
+    // Identical endpoints would switch a four colors block to the three colors mode, where index 3 is black
+    const auto count = three_colors ? uint8_t{3} : (c0 == c1 ? uint8_t{1} : uint8_t{4});
+
+    auto palette = ColorPalette{};
+    for (uint8_t p = 0; p < count; ++p)
+        for (size_t ch = 0; ch < 3; ++ch)
+            palette[p][ch] = weight[p] * first[ch] + (1.F - weight[p]) * second[ch];
+
+    auto best    = Channel{};
+    auto indices = Indices{};
+    kernels.nearest_colors(block, palette, count, best, indices);
+
+    auto error = 0.F;
+    for (size_t i = 0; i < k_pixels; ++i)
+    {
+        error += best[i] * opaque[i];
+        indices[i] = opaque[i] != 0.F ? indices[i] : uint8_t{3};
+    }
+    return {c0, c1, indices, error};
+}
+
+[[nodiscard]] static auto mean_color(const Block &block, const Channel &opaque, float count) noexcept -> Rgb
+{
+    auto mean = Rgb{};
+    for (size_t ch = 0; ch < 3; ++ch)
+    {
+        for (size_t i = 0; i < k_pixels; ++i)
+            mean[ch] += block.channels[ch][i] * opaque[i];
+        mean[ch] /= count;
+    }
+    return mean;
+}
+
+/// Corners of the bounding box of the block, inset to account for the interpolated colors
+[[nodiscard]] static auto bounding_box_endpoints(const Block &block,
+                                                 const Channel &opaque,
+                                                 float count) noexcept -> std::pair<Rgb, Rgb>
+{
+    auto low  = Rgb{};
+    auto high = Rgb{};
+    for (size_t ch = 0; ch < 3; ++ch)
+    {
+        low[ch]  = 255.F;
+        high[ch] = 0.F;
+        for (size_t i = 0; i < k_pixels; ++i)
+        {
+            const auto value = block.channels[ch][i];
+            low[ch]          = std::min(low[ch], opaque[i] != 0.F ? value : 255.F);
+            high[ch]         = std::max(high[ch], opaque[i] != 0.F ? value : 0.F);
+        }
+        const auto inset = (high[ch] - low[ch]) / 16.F;
+        low[ch] += inset;
+        high[ch] -= inset;
+    }
+
+    // The box has four diagonals. Channels varying against green use the other ones.
+    const auto mean = mean_color(block, opaque, count);
+    for (size_t ch : {size_t{0}, size_t{2}})
+    {
+        auto covariance = 0.F;
+        for (size_t i = 0; i < k_pixels; ++i)
+            covariance += (block.channels[ch][i] - mean[ch]) * (block.channels[1][i] - mean[1]) * opaque[i];
+        if (covariance < 0.F)
+            std::swap(low[ch], high[ch]);
+    }
+    return {high, low};
+}
+
+/// Extremes of the block along its principal axis
+[[nodiscard]] static auto principal_axis_endpoints(const Block &block,
+                                                   const Channel &opaque,
+                                                   float count) noexcept -> std::pair<Rgb, Rgb>
+{
+    const auto mean = mean_color(block, opaque, count);
+
+    auto covariance = std::array<Rgb, 3>{};
+    for (size_t a = 0; a < 3; ++a)
+    {
+        for (size_t b = a; b < 3; ++b)
+        {
+            for (size_t i = 0; i < k_pixels; ++i)
+                covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b])
+                                    * opaque[i];
+            covariance[b][a] = covariance[a][b];
+        }
+    }
+
+    // Power iteration, converges quickly as blocks are usually elongated
+    constexpr int iterations = 8;
+    auto axis                = Rgb{1.F, 1.F, 1.F};
+    for (int it = 0; it < iterations; ++it)
+    {
+        auto next = Rgb{};
+        for (size_t a = 0; a < 3; ++a)
+            next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+
+        const auto norm = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+        if (norm == 0.F)
+            break; // Single color block, any axis works
+        for (size_t a = 0; a < 3; ++a)
+            axis[a] = next[a] / norm;
+    }
+
+    const auto length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    auto low          = std::numeric_limits<float>::max();
+    auto high         = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < k_pixels; ++i)
+    {
+        auto projection = 0.F;
+        for (size_t ch = 0; ch < 3; ++ch)
+            projection += (block.channels[ch][i] - mean[ch]) * axis[ch];
+        projection /= length;
+        low  = std::min(low, opaque[i] != 0.F ? projection : low);
+        high = std::max(high, opaque[i] != 0.F ? projection : high);
+    }
+
+    auto first  = Rgb{};
+    auto second = Rgb{};
+    for (size_t ch = 0; ch < 3; ++ch)
+    {
+        first[ch]  = mean[ch] + axis[ch] * high;
+        second[ch] = mean[ch] + axis[ch] * low;
+    }
+    return {first, second};
+}
+
+/// Endpoints minimizing the squared error of the block for the given indices
+[[nodiscard]] static auto least_squares_endpoints(const Block &block,
+                                                  const Channel &opaque,
+                                                  const ColorFit &fit,
+                                                  bool three_colors) noexcept
+    -> std::optional<std::pair<Rgb, Rgb>>
+{
+    const auto &weight = three_colors ? k_three_colors_weights : k_four_colors_weights;
+
+    auto aa = 0.F;
+    auto ab = 0.F;
+    auto bb = 0.F;
+    auto ax = Rgb{};
+    auto bx = Rgb{};
+    for (size_t i = 0; i < k_pixels; ++i)
+    {
+        const auto a = weight[fit.indices[i]] * opaque[i];
+        const auto b = (1.F - weight[fit.indices[i]]) * opaque[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            ax[ch] += a * block.channels[ch][i];
+            bx[ch] += b * block.channels[ch][i];
+        }
+    }
+
+    const auto determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6F)
+        return std::nullopt;
+
+    auto first  = Rgb{};
+    auto second = Rgb{};
+    for (size_t ch = 0; ch < 3; ++ch)
+    {
+        first[ch]  = (ax[ch] * bb - bx[ch] * ab) / determinant;
+        second[ch] = (bx[ch] * aa - ax[ch] * ab) / determinant;
+    }
+    return std::pair{first, second};
+}
+
+[[nodiscard]] static auto refinement_iterations(EncodingQuality quality) noexcept -> int
+{
+    switch (quality)
+    {
+        case EncodingQuality::Fast: return 0;
+        case EncodingQuality::Normal: return 1;
+        case EncodingQuality::Max: return 4;
+    }
+    return 1;
+}
+
+/// \param bc1 Whether transparent pixels can use the three colors mode. BC3 blocks always use four colors.
+static void encode_colors(const Kernels &kernels,
+                          const Block &block,
+                          bool bc1,
+                          EncodingQuality quality,
+                          uint8_t *out) noexcept
+{
+    auto opaque = Channel{};
+    auto count  = 0.F;
+    for (size_t i = 0; i < k_pixels; ++i)
+    {
+        opaque[i] = !bc1 || block.channels[3][i] >= 128.F ? 1.F : 0.F;
+        count += opaque[i];
+    }
+
+    auto fit = ColorFit{.c0 = 0, .c1 = 0, .indices = {}, .error = 0.F};
+    fit.indices.fill(3);
+    const bool three_colors = count < static_cast<float>(k_pixels);
+    if (count > 0.F)
+    {
+        const auto [first, second] = quality == EncodingQuality::Fast
+                                         ? bounding_box_endpoints(block, opaque, count)
+                                         : principal_axis_endpoints(block, opaque, count);
+        fit = fit_colors(kernels, block, opaque, to_565(first), to_565(second), three_colors);
+
+        for (int it = 0; it < refinement_iterations(quality); ++it)
+        {
+            const auto refined = least_squares_endpoints(block, opaque, fit, three_colors);
+            if (!refined)
+                break;
+
+            const auto next = fit_colors(kernels,
+                                         block,
+                                         opaque,
+                                         to_565(refined->first),
+                                         to_565(refined->second),
+                                         three_colors);
+            if (next.error >= fit.error)
+                break;
+            fit = next;
+        }
+    }
+
+    uint32_t bits = 0;
+    for (size_t i = 0; i < k_pixels; ++i)
+        bits |= uint32_t{fit.indices[i]} << (2 * i);
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    out[0] = static_cast<uint8_t>(fit.c0);
+    out[1] = static_cast<uint8_t>(fit.c0 >> 8);
+    out[2] = static_cast<uint8_t>(fit.c1);
+    out[3] = static_cast<uint8_t>(fit.c1 >> 8);
+    for (size_t i = 0; i < 4; ++i)
+        out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+struct SingleFit
+{
+    uint8_t a0;
+    uint8_t a1;
+    Indices indices;
+    float error;
+};
+
+/// The mode is chosen by the order of the endpoints: 8 values if `a0 > a1`, otherwise 6 values, 0 and 255
+[[nodiscard]] static auto fit_single(const Kernels &kernels,
+                                     const Channel &values,
+                                     uint8_t a0,
+                                     uint8_t a1) noexcept -> SingleFit
+{
+    const auto first  = static_cast<float>(a0);
+    const auto second = static_cast<float>(a1);
+
+    auto palette = SinglePalette{first, second};
+    if (a0 > a1)
+    {
+        for (size_t p = 2; p < 8; ++p)
+            palette[p] = (static_cast<float>(8 - p) * first + static_cast<float>(p - 1) * second) / 7.F;
+    }
+    else
+    {
+        for (size_t p = 2; p < 6; ++p)
+            palette[p] = (static_cast<float>(6 - p) * first + static_cast<float>(p - 1) * second) / 5.F;
+        palette[6] = 0.F;
+        palette[7] = 255.F;
+    }
+
+    auto best    = Channel{};
+    auto indices = Indices{};
+    kernels.nearest_values(values, palette, best, indices);
+
+    auto error = 0.F;
+    for (size_t i = 0; i < k_pixels; ++i)
+        error += best[i];
+    return {a0, a1, indices, error};
+}
+
+[[nodiscard]] static auto inset_search_range(EncodingQuality quality) noexcept -> int
+{
+    switch (quality)
+    {
+        case EncodingQuality::Fast: return 0;
+        case EncodingQuality::Normal: return 2;
+        case EncodingQuality::Max: return 4;
+    }
+    return 2;
+}
+
+static void encode_single(const Kernels &kernels,
+                          const Channel &values,
+                          EncodingQuality quality,
+                          uint8_t *out) noexcept
+{
+    const auto [low_it, high_it] = std::ranges::minmax_element(values);
+    const auto low               = static_cast<uint8_t>(*low_it);
+    const auto high              = static_cast<uint8_t>(*high_it);
+
+    auto fit             = fit_single(kernels, values, high, low);
+    const auto keep_best = [&](const SingleFit &other) {
+        if (other.error < fit.error)
+            fit = other;
+    };
+
+    // Insetting the endpoints brings the interpolated values closer to clusters away from the extremes
+    const auto max_inset = inset_search_range(quality);
+    for (int inset_high = 0; inset_high <= max_inset; ++inset_high)
+        for (int inset_low = 0; inset_low <= max_inset; ++inset_low)
+            if ((inset_high != 0 || inset_low != 0) && high - inset_high > low + inset_low)
+                keep_best(fit_single(kernels,
+                                     values,
+                                     static_cast<uint8_t>(high - inset_high),
+                                     static_cast<uint8_t>(low + inset_low)));
+
+    if (quality == EncodingQuality::Max)
+    {
+        // The 6 values mode has exact 0 and 255, and spends its other values on the rest of the block
+        auto inner_low  = 255.F;
+        auto inner_high = 0.F;
+        for (const auto value : values)
+        {
+            const bool inner = value != 0.F && value != 255.F;
+            inner_low        = std::min(inner_low, inner ? value : 255.F);
+            inner_high       = std::max(inner_high, inner ? value : 0.F);
+        }
+        if (inner_low <= inner_high)
+            keep_best(fit_single(kernels,
+                                 values,
+                                 static_cast<uint8_t>(inner_low),
+                                 static_cast<uint8_t>(inner_high)));
+    }
+
+    uint64_t bits = 0;
+    for (size_t i = 0; i < k_pixels; ++i)
+        bits |= uint64_t{fit.indices[i]} << (3 * i);
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    out[0] = fit.a0;
+    out[1] = fit.a1;
+    for (size_t i = 0; i < 6; ++i)
+        out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+[[nodiscard]] static auto block_size(BcFormat format) noexcept -> size_t
+{
+    return format == BcFormat::Bc1 || format == BcFormat::Bc4 ? 8 : 16;
+}
+
+static void encode_row(const Kernels &kernels,
+                       const BlockImage &image,
+                       uint32_t block_y,
+                       BcFormat format,
+                       EncodingQuality quality)
+{
+    const auto blocks_per_row = (image.width + 3) / 4;
+    const auto size           = block_size(format);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    auto *out = image.blocks + size_t{block_y} * blocks_per_row * size;
+
+    for (uint32_t block_x = 0; block_x < blocks_per_row; ++block_x)
+    {
+        const auto block = load_block(image, block_x, block_y);
+        switch (format)
+        {
+            case BcFormat::Bc1: encode_colors(kernels, block, true, quality, out); break;
+            case BcFormat::Bc3:
+                encode_single(kernels, block.channels[3], quality, out);
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                encode_colors(kernels, block, false, quality, out + 8);
+                break;
+            case BcFormat::Bc4: encode_single(kernels, block.channels[0], quality, out); break;
+            case BcFormat::Bc5:
+                encode_single(kernels, block.channels[0], quality, out);
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                encode_single(kernels, block.channels[1], quality, out + 8);
+                break;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        out += size;
+    }
+}
+
+auto convert_bcn(std::span<const BlockImage> images,
+                 BcFormat format,
+                 EncodingQuality quality,
+                 const std::stop_token &stop,
+                 InstructionSet isa) -> tl::expected<void, Error>
+{
+    struct Row
+    {
+        const BlockImage *image;
+        uint32_t block_y;
+    };
+
+    // Rows of blocks of every image are spread over the cores, so that small mips are encoded alongside
+    auto rows = std::vector<Row>{};
+    for (const auto &image : images)
+        for (uint32_t block_y = 0; block_y < (image.height + 3) / 4; ++block_y)
+            rows.push_back({&image, block_y});
+
+    const auto selected = kernels(isa);
+    const auto count    = static_cast<int64_t>(rows.size());
+#pragma omp parallel for schedule(dynamic) num_threads(omp_thread_count())
+    for (int64_t i = 0; i < count; ++i)
+    {
+        if (stop.stop_requested())
+            continue;
+
+        const auto &row = rows[static_cast<size_t>(i)];
+        encode_row(selected, *row.image, row.block_y, format, quality);
+    }
+
+    if (stop.stop_requested())
+        return tl::make_unexpected(Error(TextureErr::Cancelled));
+    return {};
+}
+} // namespace btu::tex::detail
@@ -0,0 +1,614 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <btu/tex/detail/decompress_bcn.hpp>
+#include <btu/tex/detail/parallel.hpp>
+#include <btu/tex/detail/simd.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// BC1 colors and BC4 values, also used by BC2, BC3 and BC5, have SSE4.1 and AVX2 versions, picked at runtime
+// from the CPU. They give the same bytes as the scalar ones.
+namespace btu::tex::detail {
+constexpr size_t k_pixels = 16;
+
+using Pixels = std::array<std::array<uint8_t, 4>, k_pixels>;
+
+/**
+ * \brief Interpolates quantized endpoints, of `max` levels, and rounds the result to 8 bits.
+ *
+ * Done with floats, in the same order as DirectXTex, to round the halfway cases the same way.
+ */
+[[nodiscard]] static auto interpolate(uint32_t a, uint32_t b, float t, float max) noexcept -> uint8_t
+{
+    const auto fa = static_cast<float>(a) * (1.F / max);
+    const auto fb = static_cast<float>(b) * (1.F / max);
+    return static_cast<uint8_t>(std::lrint(std::clamp(fa + t * (fb - fa), 0.F, 1.F) * 255.F));
+}
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+/// \param bc1 BC2 and BC3 always use four colors, while BC1 uses three when the endpoints are not ordered
+static void decode_colors_scalar(const uint8_t *block, bool bc1, Pixels &out) noexcept
+{
+    const auto c0 = static_cast<uint32_t>(block[0] | block[1] << 8);
+    const auto c1 = static_cast<uint32_t>(block[2] | block[3] << 8);
+
+    const auto color = [&](float t) {
+        return std::array{interpolate(c0 >> 11, c1 >> 11, t, 31.F),
+                          interpolate((c0 >> 5) & 63, (c1 >> 5) & 63, t, 63.F),
+                          interpolate(c0 & 31, c1 & 31, t, 31.F),
+                          uint8_t{255}};
+    };
+
+    auto palette = std::array{color(0.F), color(1.F), color(1.F / 3.F), color(2.F / 3.F)};
+    if (bc1 && c0 <= c1)
+    {
+        palette[2] = color(0.5F);
+        palette[3] = {0, 0, 0, 0};
+    }
+
+    const auto indices = static_cast<uint32_t>(block[4] | block[5] << 8 | block[6] << 16)
+                         | static_cast<uint32_t>(block[7]) << 24;
+    for (size_t i = 0; i < k_pixels; ++i)
+        out[i] = palette[(indices >> (2 * i)) & 3];
+}
+
+/// BC4 block, also used for the alpha of BC3 and both channels of BC5. Rounding these integers gives the same
+/// result as DirectXTex's floats.
+static void decode_single_scalar(const uint8_t *block, size_t channel, Pixels &out) noexcept
+{
+    const uint32_t a0 = block[0];
+    const uint32_t a1 = block[1];
+
+    auto palette = std::array<uint8_t, 8>{block[0], block[1]};
+    if (a0 > a1)
+    {
+        for (uint32_t k = 1; k < 7; ++k)
+            palette[k + 1] = static_cast<uint8_t>(((7 - k) * a0 + k * a1 + 3) / 7);
+    }
+    else
+    {
+        for (uint32_t k = 1; k < 5; ++k)
+            palette[k + 1] = static_cast<uint8_t>(((5 - k) * a0 + k * a1 + 2) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (size_t i = 0; i < 6; ++i)
+        indices |= uint64_t{block[2 + i]} << (8 * i);
+    for (size_t i = 0; i < k_pixels; ++i)
+        out[i][channel] = palette[(indices >> (3 * i)) & 7];
+}
+
+static void decode_explicit_alpha(const uint8_t *block, Pixels &out) noexcept
+{
+    for (size_t i = 0; i < k_pixels; ++i)
+        out[i][3] = static_cast<uint8_t>(((block[i / 2] >> (4 * (i % 2))) & 15) * 17);
+}
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+#if BTU_BCN_X86
+/// Copies byte `i / 4` to byte `i`, so that each byte of four pixels is spread over their channels
+BTU_BCN_TARGET("sse4.1")
+static auto spread_mask_sse41() noexcept -> __m128i
+{
+    return _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+}
+
+/// Same as `interpolate`, for the red, green and blue lanes at once
+BTU_BCN_TARGET("sse4.1")
+static auto interpolate_sse41(__m128 a, __m128 b, float t) noexcept -> __m128i
+{
+    const auto value   = _mm_add_ps(a, _mm_mul_ps(_mm_set1_ps(t), _mm_sub_ps(b, a)));
+    const auto clamped = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.F));
+    // Rounds to nearest even, like lrint
+    return _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(255.F)));
+}
+
+/// \return The red, green and blue of a RGB565 endpoint, between 0 and 1
+BTU_BCN_TARGET("sse4.1")
+static auto endpoint_sse41(int c) noexcept -> __m128
+{
+    const auto scale = _mm_setr_ps(1.F / 31.F, 1.F / 63.F, 1.F / 31.F, 0.F);
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(c >> 11, (c >> 5) & 63, c & 31, 0)), scale);
+}
+
+/// \return The four RGBA colors of the palette, one per 32 bits lane
+BTU_BCN_TARGET("sse4.1")
+static auto color_palette_sse41(const uint8_t *block, bool bc1) noexcept -> __m128i
+{
+    const auto c0 = block[0] | block[1] << 8;
+    const auto c1 = block[2] | block[3] << 8;
+    const auto a  = endpoint_sse41(c0);
+    const auto b  = endpoint_sse41(c1);
+
+    const bool three_colors = bc1 && c0 <= c1;
+    const auto first = _mm_packs_epi32(interpolate_sse41(a, b, 0.F), interpolate_sse41(a, b, 1.F));
+    const auto second
+        = three_colors
+              ? _mm_packs_epi32(interpolate_sse41(a, b, 0.5F), _mm_setzero_si128())
+              : _mm_packs_epi32(interpolate_sse41(a, b, 1.F / 3.F), interpolate_sse41(a, b, 2.F / 3.F));
+
+    constexpr auto opaque = static_cast<int>(0xFF000000U);
+    const auto alpha = three_colors ? _mm_setr_epi32(opaque, opaque, opaque, 0) : _mm_set1_epi32(opaque);
+    return _mm_or_si128(_mm_packus_epi16(first, second), alpha);
+}
+
+BTU_BCN_TARGET("sse4.1")
+static void decode_colors_sse41(const uint8_t *block, bool bc1, Pixels &out) noexcept
+{
+    const auto palette = color_palette_sse41(block, bc1);
+
+    // Each byte of indices is copied to its four pixels. Their two bits are masked in place, the upper ones
+    // after a shift, and looked up as byte offsets in the palette.
+    auto indices = uint32_t{0};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    std::memcpy(&indices, block + 4, sizeof(indices));
+    const auto spread  = spread_mask_sse41();
+    const auto bytes   = _mm_shuffle_epi8(_mm_cvtsi32_si128(static_cast<int>(indices)), spread);
+    const auto low     = _mm_and_si128(bytes, _mm_set1_epi32(0x0C03));
+    const auto high    = _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi32(0x0C030000));
+    const auto lookup  = _mm_setr_epi8(0, 4, 8, 12, 4, 0, 0, 0, 8, 0, 0, 0, 12, 0, 0, 0);
+    const auto offsets = _mm_shuffle_epi8(lookup, _mm_or_si128(low, high));
+
+    for (size_t i = 0; i < k_pixels; i += 4)
+    {
+        const auto first  = _mm_add_epi8(spread, _mm_set1_epi8(static_cast<char>(i)));
+        const auto gather = _mm_add_epi8(_mm_shuffle_epi8(offsets, first), _mm_set1_epi32(0x03020100));
+        const auto colors = _mm_shuffle_epi8(palette, gather);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i].data()), colors);
+    }
+}
+
+/// \return `a0 * w0 + a1 * w1 + bias` in each 16 bits lane
+BTU_BCN_TARGET("sse4.1")
+static auto weighted_sse41(const uint8_t *block, __m128i w0, __m128i w1, int16_t bias) noexcept -> __m128i
+{
+    const auto a0 = _mm_set1_epi16(block[0]);
+    const auto a1 = _mm_set1_epi16(block[1]);
+    const auto sum = _mm_add_epi16(_mm_mullo_epi16(a0, w0), _mm_mullo_epi16(a1, w1));
+    return _mm_add_epi16(sum, _mm_set1_epi16(bias));
+}
+
+/// \return The eight values of the palette, in the lower bytes
+BTU_BCN_TARGET("sse4.1")
+static auto single_palette_sse41(const uint8_t *block) noexcept -> __m128i
+{
+    // Divisions are multiplications by the inverse, exact for these sums
+    if (block[0] > block[1])
+    {
+        const auto sum = weighted_sse41(block,
+                                        _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1),
+                                        _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6),
+                                        3);
+        const auto values = _mm_mulhi_epu16(sum, _mm_set1_epi16(9363));
+        return _mm_packus_epi16(values, values);
+    }
+
+    const auto sum    = weighted_sse41(block,
+                                    _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0),
+                                    _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0),
+                                    2);
+    const auto values = _mm_or_si128(_mm_mulhi_epu16(sum, _mm_set1_epi16(13108)),
+                                     _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+    return _mm_packus_epi16(values, values);
+}
+
+/// \return The value of each pixel
+BTU_BCN_TARGET("sse4.1")
+static auto single_values_sse41(const uint8_t *block) noexcept -> __m128i
+{
+    auto indices = uint64_t{0};
+    std::memcpy(&indices, block + 2, 6); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&indices));
+
+    // Each pixel gets the two bytes holding its three bits, shifted to the top of its 16 bits lane
+    const auto shifts = _mm_setr_epi16(1 << 13, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+    const auto first  = _mm_setr_epi8(0, 1, 0, 1, 0, 1, 1, 2, 1, 2, 1, 2, 2, 3, 2, 3);
+    const auto second = _mm_add_epi8(first, _mm_set1_epi8(3));
+    const auto words  = std::array{_mm_shuffle_epi8(bytes, first), _mm_shuffle_epi8(bytes, second)};
+    const auto index  = _mm_packus_epi16(_mm_srli_epi16(_mm_mullo_epi16(words[0], shifts), 13),
+                                        _mm_srli_epi16(_mm_mullo_epi16(words[1], shifts), 13));
+    return _mm_shuffle_epi8(single_palette_sse41(block), index);
+}
+
+/// Values are copied to every byte of their pixel, and blended in the channel
+BTU_BCN_TARGET("sse4.1")
+static void decode_single_sse41(const uint8_t *block, size_t channel, Pixels &out) noexcept
+{
+    const auto values = single_values_sse41(block);
+    const auto spread = spread_mask_sse41();
+    const auto select = _mm_set1_epi32(static_cast<int>(0xFFU << (8 * channel)));
+    for (size_t i = 0; i < k_pixels; i += 4)
+    {
+        auto *pixels             = reinterpret_cast<__m128i *>(out[i].data());
+        const auto first         = _mm_add_epi8(spread, _mm_set1_epi8(static_cast<char>(i)));
+        const auto spread_values = _mm_shuffle_epi8(values, first);
+        _mm_storeu_si128(pixels, _mm_blendv_epi8(_mm_loadu_si128(pixels), spread_values, select));
+    }
+}
+
+BTU_BCN_TARGET("avx2")
+static void decode_colors_avx2(const uint8_t *block, bool bc1, Pixels &out) noexcept
+{
+    // Both halves hold the palette, so the bits left above each index do not matter
+    const auto palette = _mm256_broadcastsi128_si256(color_palette_sse41(block, bc1));
+
+    auto indices = uint32_t{0};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    std::memcpy(&indices, block + 4, sizeof(indices));
+    const auto all    = _mm256_set1_epi32(static_cast<int>(indices));
+    const auto shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    for (size_t i = 0; i < k_pixels; i += 8)
+    {
+        const auto pixel_shifts = _mm256_add_epi32(shifts, _mm256_set1_epi32(static_cast<int>(2 * i)));
+        const auto colors       = _mm256_permutevar8x32_epi32(palette, _mm256_srlv_epi32(all, pixel_shifts));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[i].data()), colors);
+    }
+}
+
+BTU_BCN_TARGET("avx2")
+static void decode_single_avx2(const uint8_t *block, size_t channel, Pixels &out) noexcept
+{
+    const auto values = _mm256_broadcastsi128_si256(single_values_sse41(block));
+    const auto spread = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, //
+                                         4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+    const auto select = _mm256_set1_epi32(static_cast<int>(0xFFU << (8 * channel)));
+    for (size_t i = 0; i < k_pixels; i += 8)
+    {
+        auto *pixels             = reinterpret_cast<__m256i *>(out[i].data());
+        const auto first         = _mm256_add_epi8(spread, _mm256_set1_epi8(static_cast<char>(i)));
+        const auto spread_values = _mm256_shuffle_epi8(values, first);
+        _mm256_storeu_si256(pixels, _mm256_blendv_epi8(_mm256_loadu_si256(pixels), spread_values, select));
+    }
+}
+#endif
+
+struct Kernels
+{
+    decltype(&decode_colors_scalar) decode_colors;
+    decltype(&decode_single_scalar) decode_single;
+};
+
+[[nodiscard]] static auto kernels(InstructionSet isa) noexcept -> Kernels
+{
+    switch (std::min(isa, best_instruction_set()))
+    {
+#if BTU_BCN_X86
+        case InstructionSet::Avx2: return {decode_colors_avx2, decode_single_avx2};
+        case InstructionSet::Sse41: return {decode_colors_sse41, decode_single_sse41};
+#endif
+        default: return {decode_colors_scalar, decode_single_scalar};
+    }
+}
+
+/// Reads a BC7 block, least significant bit first
+class BitReader
+{
+public:
+    explicit BitReader(const uint8_t *block) noexcept
+    {
+        for (size_t i = 0; i < 8; ++i)
+        {
+            // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            low_ |= uint64_t{block[i]} << (8 * i);
+            high_ |= uint64_t{block[8 + i]} << (8 * i);
+            // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        }
+    }
+
+    [[nodiscard]] auto read(uint32_t count) noexcept -> uint32_t
+    {
+        uint64_t value = 0;
+        if (pos_ == 0)
+            value = low_;
+        else if (pos_ < 64)
+            value = low_ >> pos_ | high_ << (64 - pos_);
+        else
+            value = high_ >> (pos_ - 64);
+        pos_ += count;
+        return static_cast<uint32_t>(value & ((uint64_t{1} << count) - 1));
+    }
+
+private:
+    uint64_t low_  = 0;
+    uint64_t high_ = 0;
+    uint32_t pos_  = 0;
+};
+
+struct Bc7Mode
+{
+    uint8_t subsets;
+    uint8_t partition_bits;
+    uint8_t rotation_bits;
+    uint8_t index_selection_bits;
+    uint8_t color_bits;
+    uint8_t alpha_bits;
+    /// One P-bit per endpoint
+    bool endpoint_pbits;
+    /// One P-bit per subset
+    bool shared_pbits;
+    uint8_t index_bits;
+    uint8_t secondary_index_bits;
+};
+
+constexpr auto k_bc7_modes = std::array<Bc7Mode, 8>{{
+    {3, 4, 0, 0, 4, 0, true, false, 3, 0},
+    {2, 6, 0, 0, 6, 0, false, true, 3, 0},
+    {3, 6, 0, 0, 5, 0, false, false, 2, 0},
+    {2, 6, 0, 0, 7, 0, true, false, 2, 0},
+    {1, 0, 2, 1, 5, 6, false, false, 2, 3},
+    {1, 0, 2, 0, 7, 8, false, false, 2, 2},
+    {1, 0, 0, 0, 7, 7, true, false, 4, 0},
+    {2, 6, 0, 0, 5, 5, true, false, 2, 0},
+}};
+
+/// Subset of each pixel for the two subsets partitions, one bit per pixel
+constexpr auto k_bc7_partitions2 = std::array<uint16_t, 64>{
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8,
+    0xFF00, 0xFFF0, 0xF000, 0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110,
+    0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C, 0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696,
+    0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660, 0x0272, 0x04E4, 0x4E40, 0x2720,
+    0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+/// Subset of each pixel for the three subsets partitions, two bits per pixel
+constexpr auto k_bc7_partitions3 = std::array<uint32_t, 64>{
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+    0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+    0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+    0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+    0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+    0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+/// Pixel holding the index of the second subset whose most significant bit is implicit
+constexpr auto k_bc7_anchors2 = std::array<uint8_t, 64>{
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+};
+
+/// Same for the second and third subsets of the three subsets partitions
+constexpr auto k_bc7_anchors3 = std::array<std::array<uint8_t, 2>, 64>{{
+    {3, 15},  {3, 8},   {15, 8},  {15, 3},  {8, 15},  {3, 15},  {15, 3},  {15, 8},  {8, 15},  {8, 15},
+    {6, 15},  {6, 15},  {6, 15},  {5, 15},  {3, 15},  {3, 8},   {3, 15},  {3, 8},   {8, 15},  {15, 3},
+    {3, 15},  {3, 8},   {6, 15},  {10, 8},  {5, 3},   {8, 15},  {8, 6},   {6, 10},  {8, 15},  {5, 15},
+    {15, 10}, {15, 8},  {8, 15},  {15, 3},  {3, 15},  {5, 10},  {6, 10},  {10, 8},  {8, 9},   {15, 10},
+    {15, 6},  {3, 15},  {15, 8},  {5, 15},  {15, 3},  {15, 6},  {15, 6},  {15, 8},  {3, 15},  {15, 3},
+    {5, 15},  {5, 15},  {5, 15},  {8, 15},  {5, 15},  {10, 15}, {5, 15},  {10, 15}, {8, 15},  {13, 15},
+    {15, 3},  {12, 15}, {3, 15},  {3, 8},
+}};
+
+constexpr auto k_bc7_weights2 = std::array<uint32_t, 4>{0, 21, 43, 64};
+constexpr auto k_bc7_weights3 = std::array<uint32_t, 8>{0, 9, 18, 27, 37, 46, 55, 64};
+constexpr auto k_bc7_weights4 = std::array<uint32_t, 16>{
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64,
+};
+
+[[nodiscard]] static auto bc7_weight(uint32_t bits, uint32_t index) noexcept -> uint32_t
+{
+    switch (bits)
+    {
+        case 2: return k_bc7_weights2[index];
+        case 3: return k_bc7_weights3[index];
+        default: return k_bc7_weights4[index];
+    }
+}
+
+[[nodiscard]] static auto bc7_subset(const Bc7Mode &mode, uint32_t partition, size_t pixel) noexcept
+    -> uint32_t
+{
+    switch (mode.subsets)
+    {
+        case 2: return (k_bc7_partitions2[partition] >> pixel) & 1U;
+        case 3: return (k_bc7_partitions3[partition] >> (2 * pixel)) & 3U;
+        default: return 0;
+    }
+}
+
+[[nodiscard]] static auto is_bc7_anchor(const Bc7Mode &mode, uint32_t partition, size_t pixel) noexcept
+    -> bool
+{
+    switch (mode.subsets)
+    {
+        case 2: return pixel == 0 || pixel == k_bc7_anchors2[partition];
+        case 3:
+            return pixel == 0 || pixel == k_bc7_anchors3[partition][0]
+                   || pixel == k_bc7_anchors3[partition][1];
+        default: return pixel == 0;
+    }
+}
+
+static void decode_bc7(const uint8_t *block, Pixels &out) noexcept
+{
+    auto bits = BitReader(block);
+
+    uint32_t mode_index = 0;
+    while (mode_index < k_bc7_modes.size() && bits.read(1) == 0)
+        ++mode_index;
+    // Reserved mode, decoded to transparent black like DirectXTex
+    if (mode_index == k_bc7_modes.size())
+    {
+        out = {};
+        return;
+    }
+
+    const auto &mode           = k_bc7_modes[mode_index];
+    const auto partition       = bits.read(mode.partition_bits);
+    const auto rotation        = bits.read(mode.rotation_bits);
+    const auto index_selection = bits.read(mode.index_selection_bits);
+
+    // Channels are stored one after the other, for every endpoint
+    const auto endpoint_count = size_t{mode.subsets} * 2;
+    auto endpoints            = std::array<std::array<uint32_t, 4>, 6>{};
+    for (size_t ch = 0; ch < 4; ++ch)
+    {
+        const auto channel_bits = ch < 3 ? mode.color_bits : mode.alpha_bits;
+        for (size_t e = 0; e < endpoint_count; ++e)
+            endpoints[e][ch] = bits.read(channel_bits);
+    }
+
+    auto color_bits = uint32_t{mode.color_bits};
+    auto alpha_bits = uint32_t{mode.alpha_bits};
+    if (mode.endpoint_pbits || mode.shared_pbits)
+    {
+        auto pbits = std::array<uint32_t, 6>{};
+        for (size_t e = 0; e < endpoint_count; ++e)
+            pbits[e] = mode.endpoint_pbits || e % 2 == 0 ? bits.read(1) : pbits[e - 1];
+        for (size_t e = 0; e < endpoint_count; ++e)
+            for (auto &channel : endpoints[e])
+                channel = channel << 1 | pbits[e];
+        ++color_bits;
+        alpha_bits += alpha_bits != 0 ? 1 : 0;
+    }
+
+    const auto expand = [](uint32_t value, uint32_t count) {
+        value <<= 8 - count;
+        return value | value >> count;
+    };
+    for (size_t e = 0; e < endpoint_count; ++e)
+    {
+        for (size_t ch = 0; ch < 3; ++ch)
+            endpoints[e][ch] = expand(endpoints[e][ch], color_bits);
+        endpoints[e][3] = alpha_bits != 0 ? expand(endpoints[e][3], alpha_bits) : 255;
+    }
+
+    auto indices           = std::array<uint32_t, k_pixels>{};
+    auto secondary_indices = std::array<uint32_t, k_pixels>{};
+    for (size_t i = 0; i < k_pixels; ++i)
+        indices[i] = bits.read(mode.index_bits - (is_bc7_anchor(mode, partition, i) ? 1 : 0));
+    if (mode.secondary_index_bits != 0)
+        for (size_t i = 0; i < k_pixels; ++i)
+            secondary_indices[i] = bits.read(mode.secondary_index_bits - (i == 0 ? 1 : 0));
+
+    // Modes 4 and 5 have separate indices for colors and alpha, the index selection bit swaps them
+    const bool swap_indices = index_selection != 0;
+    const auto single_set   = mode.secondary_index_bits == 0;
+    const auto color_bits_n = swap_indices ? mode.secondary_index_bits : mode.index_bits;
+    const auto alpha_bits_n = single_set || swap_indices ? mode.index_bits : mode.secondary_index_bits;
+
+    for (size_t i = 0; i < k_pixels; ++i)
+    {
+        const auto subset = bc7_subset(mode, partition, i);
+        const auto &e0    = endpoints[2 * subset];
+        const auto &e1    = endpoints[2 * subset + 1];
+
+        const auto color_index = swap_indices ? secondary_indices[i] : indices[i];
+        const auto alpha_index = single_set || swap_indices ? indices[i] : secondary_indices[i];
+        const auto color_w     = bc7_weight(color_bits_n, color_index);
+        const auto alpha_w     = bc7_weight(alpha_bits_n, alpha_index);
+
+        for (size_t ch = 0; ch < 3; ++ch)
+            out[i][ch] = static_cast<uint8_t>(((64 - color_w) * e0[ch] + color_w * e1[ch] + 32) >> 6);
+        out[i][3] = static_cast<uint8_t>(((64 - alpha_w) * e0[3] + alpha_w * e1[3] + 32) >> 6);
+
+        if (rotation != 0)
+            std::swap(out[i][3], out[i][rotation - 1]);
+    }
+}
+
+static void decode_block(DXGI_FORMAT format,
+                         const uint8_t *block,
+                         const Kernels &kernels,
+                         Pixels &out) noexcept
+{
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    switch (format)
+    {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB: kernels.decode_colors(block, true, out); break;
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            kernels.decode_colors(block + 8, false, out);
+            decode_explicit_alpha(block, out);
+            break;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            kernels.decode_colors(block + 8, false, out);
+            kernels.decode_single(block, 3, out);
+            break;
+        case DXGI_FORMAT_BC4_UNORM:
+            out.fill({0, 0, 0, 255});
+            kernels.decode_single(block, 0, out);
+            break;
+        case DXGI_FORMAT_BC5_UNORM:
+            out.fill({0, 0, 0, 255});
+            kernels.decode_single(block, 0, out);
+            kernels.decode_single(block + 8, 1, out);
+            break;
+        default: decode_bc7(block, out); break;
+    }
+    // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+static void decode_row(const DirectX::Image &source,
+                       const DirectX::Image &target,
+                       size_t block_y,
+                       const Kernels &kernels) noexcept
+{
+    const auto channels   = DirectX::BitsPerPixel(target.format) / 8;
+    const auto block_size = DirectX::BitsPerPixel(source.format) * 2;
+    const auto rows       = std::min<size_t>(4, source.height - block_y * 4);
+
+    auto pixels = Pixels{};
+    for (size_t block_x = 0; block_x * 4 < source.width; ++block_x)
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        decode_block(source.format,
+                     source.pixels + block_y * source.rowPitch + block_x * block_size,
+                     kernels,
+                     pixels);
+
+        // Blocks on the edges of images whose size is not a multiple of 4 are cropped
+        const auto columns = std::min<size_t>(4, source.width - block_x * 4);
+        for (size_t y = 0; y < rows; ++y)
+        {
+            auto *dst = target.pixels + (block_y * 4 + y) * target.rowPitch + block_x * 4 * channels;
+            // Pixels of a row are contiguous, and copied at once when no channel is dropped
+            if (channels == 4)
+                std::memcpy(dst, pixels[y * 4].data(), columns * 4);
+            else
+                for (size_t x = 0; x < columns; ++x)
+                    std::memcpy(dst + x * channels, pixels[y * 4 + x].data(), channels);
+        }
+        // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    }
+}
+
+void decompress_bcn(std::span<const DirectX::Image> sources,
+                    std::span<const DirectX::Image> targets,
+                    InstructionSet isa)
+{
+    struct Row
+    {
+        size_t image;
+        size_t block_y;
+    };
+
+    // Rows of blocks of every image are spread over the cores, so that small mips are decoded alongside
+    auto rows = std::vector<Row>{};
+    for (size_t i = 0; i < sources.size(); ++i)
+        for (size_t block_y = 0; block_y * 4 < sources[i].height; ++block_y)
+            rows.push_back({i, block_y});
+
+    const auto selected = kernels(isa);
+    const auto count    = static_cast<int64_t>(rows.size());
+#pragma omp parallel for schedule(dynamic) num_threads(omp_thread_count())
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const auto &row = rows[static_cast<size_t>(i)];
+        decode_row(sources[row.image], targets[row.image], row.block_y, selected);
+    }
+}
+} // namespace btu::tex::detail
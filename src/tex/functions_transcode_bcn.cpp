@@ -0,0 +1,212 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <btu/tex/detail/transcode_bcn.hpp>
+
+#include <array>
+#include <cstring>
+
+namespace btu::tex::detail {
+constexpr size_t k_pixels = 16;
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+[[nodiscard]] static auto read_u16(const uint8_t *bytes) noexcept -> uint32_t
+{
+    return static_cast<uint32_t>(bytes[0] | bytes[1] << 8);
+}
+
+[[nodiscard]] static auto read_u32(const uint8_t *bytes) noexcept -> uint32_t
+{
+    return read_u16(bytes) | read_u16(bytes + 2) << 16;
+}
+
+/// Whether the BC4 block used for the alpha of BC3 decodes to 255 everywhere
+[[nodiscard]] static auto is_opaque_alpha(const uint8_t *block) noexcept -> bool
+{
+    const uint32_t a0 = block[0];
+    const uint32_t a1 = block[1];
+
+    auto palette = std::array<uint32_t, 8>{a0, a1};
+    if (a0 > a1)
+    {
+        for (uint32_t k = 1; k < 7; ++k)
+            palette[k + 1] = ((7 - k) * a0 + k * a1 + 3) / 7;
+    }
+    else
+    {
+        for (uint32_t k = 1; k < 5; ++k)
+            palette[k + 1] = ((5 - k) * a0 + k * a1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (size_t i = 0; i < 6; ++i)
+        indices |= uint64_t{block[2 + i]} << (8 * i);
+    for (size_t i = 0; i < k_pixels; ++i)
+        if (palette[(indices >> (3 * i)) & 7] != 255)
+            return false;
+    return true;
+}
+
+/// Whether any pixel of a BC1 block uses index `index`
+[[nodiscard]] static auto uses_index(const uint8_t *block, uint32_t index) noexcept -> bool
+{
+    const auto indices = read_u32(block + 4);
+    for (size_t i = 0; i < k_pixels; ++i)
+        if (((indices >> (2 * i)) & 3) == index)
+            return true;
+    return false;
+}
+
+[[nodiscard]] static auto can_transcode_block(Transcoding transcoding, const uint8_t *block) noexcept -> bool
+{
+    switch (transcoding)
+    {
+        case Transcoding::Bc3ToBc1: return is_opaque_alpha(block);
+        case Transcoding::Bc1ToBc7:
+        {
+            const auto c0 = read_u16(block);
+            const auto c1 = read_u16(block + 2);
+            // The three colors mode has a color halfway between the endpoints, which no BC7 weight gives.
+            // A single color is fine, as long as the transparent index is not used.
+            return c0 > c1 || (c0 == c1 && !uses_index(block, 3));
+        }
+    }
+    return false;
+}
+
+/// BC3 colors always use four colors, while BC1 needs ordered endpoints to do so
+static void bc3_to_bc1(const uint8_t *block, uint8_t *out) noexcept
+{
+    std::memcpy(out, block + 8, 8);
+
+    const auto c0 = read_u16(out);
+    const auto c1 = read_u16(out + 2);
+    if (c0 > c1)
+        return;
+
+    if (c0 == c1)
+    {
+        // Every index gives the same color
+        std::memset(out + 4, 0, 4);
+        return;
+    }
+
+    // Swapping the endpoints swaps indices 0 and 1, as well as 2 and 3
+    std::swap(out[0], out[2]);
+    std::swap(out[1], out[3]);
+    for (size_t i = 4; i < 8; ++i)
+        out[i] ^= 0x55;
+}
+
+/// Writes a BC7 block, least significant bit first
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t *block) noexcept
+        : block_(block)
+    {
+        std::memset(block_, 0, 16);
+    }
+
+    void write(uint32_t value, uint32_t count) noexcept
+    {
+        for (uint32_t i = 0; i < count; ++i, ++pos_)
+            block_[pos_ / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (pos_ % 8));
+    }
+
+private:
+    uint8_t *block_;
+    uint32_t pos_ = 0;
+};
+
+static void bc1_to_bc7(const uint8_t *block, uint8_t *out) noexcept
+{
+    const auto c0 = read_u16(block);
+    const auto c1 = read_u16(block + 2);
+
+    const auto expand = [](uint32_t color) {
+        const auto r = color >> 11;
+        const auto g = (color >> 5) & 63;
+        const auto b = color & 31;
+        return std::array{r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, uint32_t{255}};
+    };
+    auto e0 = expand(c0);
+    auto e1 = expand(c1);
+
+    // Mode 6 weights closest to the BC1 ones, 1/3 and 2/3 being 21.3 and 42.7 out of 64
+    constexpr auto k_weights = std::array<uint32_t, 4>{0, 15, 5, 10};
+    auto weights             = std::array<uint32_t, k_pixels>{};
+    const auto indices       = read_u32(block + 4);
+    for (size_t i = 0; i < k_pixels; ++i)
+        weights[i] = c0 == c1 ? 0 : k_weights[(indices >> (2 * i)) & 3];
+
+    // The most significant bit of the first index is implicitly 0, reversing the endpoints makes it so
+    if (weights[0] >= 8)
+    {
+        std::swap(e0, e1);
+        for (auto &weight : weights)
+            weight = 15 - weight;
+    }
+
+    auto bits = BitWriter(out);
+    bits.write(1U << 6, 7);
+    // The shared P-bit of each endpoint is set, so that alpha is 255
+    for (size_t ch = 0; ch < 4; ++ch)
+    {
+        bits.write(e0[ch] >> 1, 7);
+        bits.write(e1[ch] >> 1, 7);
+    }
+    bits.write(1, 1);
+    bits.write(1, 1);
+    bits.write(weights[0], 3);
+    for (size_t i = 1; i < k_pixels; ++i)
+        bits.write(weights[i], 4);
+}
+
+[[nodiscard]] static auto source_block_size(Transcoding transcoding) noexcept -> size_t
+{
+    return transcoding == Transcoding::Bc3ToBc1 ? 16 : 8;
+}
+
+auto can_transcode_blocks(Transcoding transcoding, const DirectX::Image &image) noexcept -> bool
+{
+    const auto block_size = source_block_size(transcoding);
+    const auto rows       = DirectX::ComputeScanlines(image.format, image.height);
+    const auto columns    = (image.width + 3) / 4;
+    for (size_t y = 0; y < rows; ++y)
+    {
+        const auto *row = image.pixels + y * image.rowPitch;
+        for (size_t x = 0; x < columns; ++x)
+            if (!can_transcode_block(transcoding, row + x * block_size))
+                return false;
+    }
+    return true;
+}
+
+void transcode_blocks(Transcoding transcoding,
+                      const DirectX::Image &source,
+                      const DirectX::Image &target) noexcept
+{
+    const auto block_size = source_block_size(transcoding);
+    const auto rows       = DirectX::ComputeScanlines(source.format, source.height);
+    const auto columns    = (source.width + 3) / 4;
+    for (size_t y = 0; y < rows; ++y)
+    {
+        const auto *src = source.pixels + y * source.rowPitch;
+        auto *dst       = target.pixels + y * target.rowPitch;
+        for (size_t x = 0; x < columns; ++x)
+        {
+            switch (transcoding)
+            {
+                case Transcoding::Bc3ToBc1: bc3_to_bc1(src + x * block_size, dst + x * 8); break;
+                case Transcoding::Bc1ToBc7: bc1_to_bc7(src + x * block_size, dst + x * 16); break;
+            }
+        }
+    }
+}
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+} // namespace btu::tex::detail
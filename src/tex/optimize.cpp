@@ -14,24 +14,60 @@
 #include <btu/tex/dxtex.hpp>
 
 namespace btu::tex {
-auto optimize(Texture &&file, OptimizationSteps sets, CompressionDevice &dev) noexcept -> Result
+/// Fails with `TextureErr::Cancelled` if a stop was requested, to be chained between steps
+template<class Tex>
+[[nodiscard]] static auto check_stop(const std::stop_token &stop)
+{
+    return [&stop](Tex &&tex) -> tl::expected<Tex, Error> {
+        if (stop.stop_requested())
+            return tl::make_unexpected(Error(TextureErr::Cancelled));
+        return std::move(tex);
+    };
+}
+
+auto optimize(Texture &&file,
+              OptimizationSteps sets,
+              CompressionDevice &dev,
+              const std::stop_token &stop) noexcept -> Result
 {
     const auto &info = file.get().GetMetadata();
+    // Steps may have been planned for another texture, whose analysis says nothing about this one
+    if (sets.analysis && !sets.analysis->describes(file))
+        sets.analysis.reset();
+    // Existing mips already hold the downscaled texture, keep them instead of resizing and regenerating them
+    const auto dropped_mips = sets.resize ? droppable_mips(info, *sets.resize) : std::nullopt;
+    if (dropped_mips)
+    {
+        sets.resize.reset();
+        sets.mipmaps = false;
+    }
+    // Nothing left to do with the pixels, so the blocks of compressed textures are kept or rewritten as is
+    const auto pixels_kept = !sets.resize && !sets.mipmaps && !sets.add_transparent_alpha;
+    const auto untouched   = dropped_mips && pixels_kept && info.format == sets.best_format;
+    const auto transcodes  = pixels_kept && can_transcode(file, sets.best_format);
+
     // All operations require a decompressed texture.
-    const auto must_decompress = DirectX::IsCompressed(info.format);
+    const auto must_decompress = DirectX::IsCompressed(info.format) && !untouched && !transcodes;
     // Special case - force conversion if result shouldn't have alpha to get rid of alpha bits that are added by DirectX.
     const auto should_convert = sets.convert || must_decompress || !DirectX::HasAlpha(sets.best_format);
     auto res                  = Result{std::move(file)};
-
+    const auto cancelled      = check_stop<Texture>(stop);
+
+    if (dropped_mips)
+        res = std::move(res).and_then(cancelled).and_then(
+            [&](Texture &&tex) { return drop_mips(std::move(tex), *dropped_mips); });
+    if (transcodes)
+        res = std::move(res).and_then(cancelled).and_then(
+            [&](Texture &&tex) { return transcode(std::move(tex), sets.best_format); });
     if (must_decompress)
-        res = std::move(res).and_then(decompress);
+        res = std::move(res).and_then(cancelled).and_then(decompress);
     if (sets.resize)
-        res = std::move(res).and_then(
+        res = std::move(res).and_then(cancelled).and_then(
             [&](Texture &&tex) { return resize(std::move(tex), sets.resize.value()); });
     if (sets.add_transparent_alpha)
-        res = std::move(res).and_then(make_transparent_alpha);
+        res = std::move(res).and_then(cancelled).and_then(make_transparent_alpha);
     if (sets.mipmaps)
-        res = std::move(res).and_then(BTU_RESOLVE_OVERLOAD(generate_mipmaps));
+        res = std::move(res).and_then(cancelled).and_then(BTU_RESOLVE_OVERLOAD(generate_mipmaps));
 
     // We have uncompressed the texture. If it was compressed, it's best to convert it to a better format
     const auto cur_format_is_same_as_best = res && res->get().GetMetadata().format == sets.best_format;
@@ -42,11 +78,18 @@ auto optimize(Texture &&file, OptimizationSteps sets, CompressionDevice &dev) no
         res      = std::move(res)
                   // // safety check: make sure we don't remove the alpha
                   .and_then([&](Texture &&tex) -> Result {
-                      if (!DirectX::HasAlpha(out) && !tex.get().IsAlphaAllOpaque())
+                      // Steps do not make an opaque texture transparent, except for `add_transparent_alpha`,
+                      // which requires a format with alpha
+                      const auto opaque = [&] {
+                          return sets.analysis ? sets.analysis->opaque_alpha() : tex.get().IsAlphaAllOpaque();
+                      };
+                      if (!DirectX::HasAlpha(out) && !opaque())
                           return tl::make_unexpected(Error(TextureErr::BadInput));
                       return std::move(tex);
                   })
-                  .and_then([&](Texture &&tex) { return convert(std::move(tex), out, dev); });
+                  .and_then([&](Texture &&tex) {
+                      return convert(std::move(tex), out, dev, sets.quality, sets.bc_encoder, stop);
+                  });
     }
 
     return res;
@@ -54,37 +97,65 @@ auto optimize(Texture &&file, OptimizationSteps sets, CompressionDevice &dev) no
 
 auto optimize(CrunchTexture &&file,
               OptimizationSteps sets,
-              [[maybe_unused]] CompressionDevice &dev) noexcept -> ResultCrunch
+              [[maybe_unused]] CompressionDevice &dev,
+              const std::stop_token &stop) noexcept -> ResultCrunch
 {
     const auto must_decompress = file.get().is_packed() && (sets.resize || sets.mipmaps);
     const auto should_convert  = sets.convert || must_decompress;
 
-    auto res = ResultCrunch{std::move(file)};
+    auto res             = ResultCrunch{std::move(file)};
+    const auto cancelled = check_stop<CrunchTexture>(stop);
 
     if (sets.resize)
-        res = std::move(res).and_then(
+        res = std::move(res).and_then(cancelled).and_then(
             [&](CrunchTexture &&tex) { return resize(std::move(tex), sets.resize.value()); });
     if (sets.mipmaps)
-        res = std::move(res).and_then(BTU_RESOLVE_OVERLOAD(generate_mipmaps));
+        res = std::move(res).and_then(cancelled).and_then(BTU_RESOLVE_OVERLOAD(generate_mipmaps));
     if (should_convert)
-        res = std::move(res).and_then(
-            [&](CrunchTexture &&tex) { return convert(std::move(tex), sets.best_format); });
+        res = std::move(res).and_then(cancelled).and_then([&](CrunchTexture &&tex) {
+            return convert(std::move(tex), sets.best_format, sets.quality, stop);
+        });
 
     return res;
 }
 
+/// Pixels are only needed to know whether alpha is opaque, so textures without alpha are not analyzed
+[[nodiscard]] static auto analyze_alpha(const Texture &file) noexcept -> std::optional<SourceAnalysis>
+{
+    const auto format = file.get().GetMetadata().format;
+    if (!DirectX::HasAlpha(format))
+        return std::nullopt;
+
+    auto res = analyze(file);
+    if (!res)
+        return std::nullopt;
+    return SourceAnalysis{*res, file.get_dimension(), format};
+}
+
+auto SourceAnalysis::describes(const Texture &file) const noexcept -> bool
+{
+    return dimension == file.get_dimension() && format == file.get().GetMetadata().format;
+}
+
+/// Same as `ScratchImage::IsAlphaAllOpaque`, without scanning the pixels again if they were analyzed
+[[nodiscard]] static auto is_alpha_all_opaque(const ScratchImage &tex,
+                                              const std::optional<SourceAnalysis> &analysis) noexcept -> bool
+{
+    if (!DirectX::HasAlpha(tex.GetMetadata().format))
+        return true;
+    return analysis ? analysis->opaque_alpha() : tex.IsAlphaAllOpaque();
+}
+
 /// SSE landscape textures uses alpha channel as specularity
 /// Textures with opaque alpha are thus rendered shiny
 /// To fix this, alpha has to be made transparent
-[[nodiscard]] static auto transparent_alpha_required(const Texture &file, const Settings &sets) -> bool
+[[nodiscard]] static auto transparent_alpha_required(const Path &load_path,
+                                                     const Settings &sets,
+                                                     const bool opaque_alpha) -> bool
 {
-    const auto &tex         = file.get();
-    const auto path         = canonize_path(file.get_load_path());
+    const auto path         = canonize_path(load_path);
     const bool is_landscape = common::contains(sets.landscape_textures, path);
-    if (!is_landscape)
-        return false;
-
-    return tex.IsAlphaAllOpaque();
+    return is_landscape && opaque_alpha;
 }
 
 [[nodiscard]] static auto is_bad_cubemap(const TexMetadata &info) noexcept -> bool
@@ -99,19 +170,17 @@ auto optimize(CrunchTexture &&file,
     return is_cubemap && uncompressed && bad_alpha;
 }
 
-[[nodiscard]] static auto has_opaque_alpha(const ScratchImage &tex) noexcept -> bool
+[[nodiscard]] static auto has_opaque_alpha(const TexMetadata &info, const bool opaque_alpha) noexcept -> bool
 {
     using enum DirectX::TEX_ALPHA_MODE;
 
-    const auto has_alpha  = DirectX::HasAlpha(tex.GetMetadata().format);
-    const auto alpha_mode = tex.GetMetadata().GetAlphaMode();
-    return !has_alpha || alpha_mode == TEX_ALPHA_MODE_OPAQUE || tex.IsAlphaAllOpaque();
+    const auto has_alpha  = DirectX::HasAlpha(info.format);
+    const auto alpha_mode = info.GetAlphaMode();
+    return !has_alpha || alpha_mode == TEX_ALPHA_MODE_OPAQUE || opaque_alpha;
 }
 
-template<class Tex>
-[[nodiscard]] static auto can_be_compressed(const Tex &file) noexcept -> bool
+[[nodiscard]] static auto can_be_compressed(const Dimension dim) noexcept -> bool
 {
-    const Dimension dim  = file.get_dimension();
     const bool too_small = dim.w < 4 || dim.h < 4;
     const bool pow2      = util::is_pow2(dim.w) && util::is_pow2(dim.h);
 
@@ -119,11 +188,16 @@ template<class Tex>
 }
 
 template<class Tex>
-[[nodiscard]] static auto is_tga(const Tex &file) noexcept -> bool
+[[nodiscard]] static auto can_be_compressed(const Tex &file) noexcept -> bool
+{
+    return can_be_compressed(file.get_dimension());
+}
+
+[[nodiscard]] static auto is_tga(const Path &path) noexcept -> bool
 {
     try
     {
-        const auto ext = file.get_load_path().extension();
+        const auto ext = path.extension();
         return str_compare(ext.u8string(), u8".tga", common::CaseSensitive::No);
     }
     catch (const std::exception &)
@@ -132,17 +206,23 @@ template<class Tex>
     }
 }
 
-[[nodiscard]] static auto conversion_required(const Texture &file, const Settings &sets) noexcept -> bool
+template<class Tex>
+[[nodiscard]] static auto is_tga(const Tex &file) noexcept -> bool
 {
-    const auto &info = file.get().GetMetadata();
+    return is_tga(file.get_load_path());
+}
 
+[[nodiscard]] static auto conversion_required(const TexMetadata &info,
+                                              const Path &path,
+                                              const Settings &sets) noexcept -> bool
+{
     const bool forbidden_format = sets.use_format_whitelist
                                   && !common::contains(sets.allowed_formats, info.format);
 
     const bool is_bad_cube = is_bad_cubemap(info);
     const bool bad         = forbidden_format || is_bad_cube;
 
-    return bad || is_tga(file);
+    return bad || is_tga(path);
 }
 
 [[nodiscard]] static auto target_dimensions(const Dimension dim,
@@ -160,17 +240,17 @@ template<class Tex>
                       sets.resize);
 }
 
-[[nodiscard]] static auto best_output_format(const Texture &file,
+[[nodiscard]] static auto best_output_format(const TexMetadata &info,
                                              const Settings &sets,
-                                             const bool force_alpha) noexcept -> DXGI_FORMAT
+                                             const bool force_alpha,
+                                             const bool opaque_alpha) noexcept -> DXGI_FORMAT
 {
-    const auto &tex  = file.get();
-    const auto &info = tex.GetMetadata();
+    const auto dim = Dimension{.w = info.width, .h = info.height};
 
     return guess_best_format(info.format,
                              sets.output_format,
-                             GuessBestFormatArgs{.opaque_alpha     = has_opaque_alpha(tex),
-                                                 .allow_compressed = sets.compress && can_be_compressed(file),
+                             GuessBestFormatArgs{.opaque_alpha     = has_opaque_alpha(info, opaque_alpha),
+                                                 .allow_compressed = sets.compress && can_be_compressed(dim),
                                                  .force_alpha      = force_alpha});
 }
 
@@ -188,15 +268,17 @@ template<class Tex>
                                                  .force_alpha = force_alpha});
 }
 
-auto compute_optimization_steps(const Texture &file, const Settings &sets) noexcept -> OptimizationSteps
+/// Plans the steps from the metadata of a texture.
+/// \param opaque_alpha Whether every alpha of the pixels is 255, the only fact the pixels are needed for
+[[nodiscard]] static auto compute_steps(const TexMetadata &info,
+                                        const Path &path,
+                                        const Settings &sets,
+                                        const bool opaque_alpha) noexcept -> OptimizationSteps
 {
-    const auto &tex  = file.get();
-    const auto &info = tex.GetMetadata();
-
     auto res = OptimizationSteps{};
 
     // Check if conversion is a must.
-    res.convert = conversion_required(file, sets);
+    res.convert = conversion_required(info, path, sets);
 
     // Do not compress the image if already compressed.
     if (sets.compress && !DirectX::IsCompressed(info.format))
@@ -209,20 +291,90 @@ auto compute_optimization_steps(const Texture &file, const Settings &sets) noexc
         res.resize = target_dim.value();
 
     if (sets.game == Game::SSE)
-        if (transparent_alpha_required(file, sets))
+        if (transparent_alpha_required(path, sets, !DirectX::HasAlpha(info.format) || opaque_alpha))
             res.add_transparent_alpha = true;
 
-    const bool opt_mip = optimal_mip_count(file.get_dimension()) == info.mipLevels;
+    const bool opt_mip = optimal_mip_count(dim) == info.mipLevels;
     if ((sets.mipmaps && !opt_mip)
         || (info.mipLevels > 1 && res.resize)) // resize removes mips if there are any, regenerate them
         res.mipmaps = true;
 
     // I prefer to keep steps independent, but this one has to depend on add_transparent_alpha. If we add an alpha, the output format must have alpha
-    res.best_format = best_output_format(file, sets, res.add_transparent_alpha);
+    res.best_format = best_output_format(info, sets, res.add_transparent_alpha, opaque_alpha);
+    res.quality     = sets.quality;
+    res.bc_encoder  = sets.bc_encoder;
 
     return res;
 }
 
+auto compute_optimization_steps(const Texture &file, const Settings &sets) noexcept -> OptimizationSteps
+{
+    const auto &tex = file.get();
+
+    // Pixels are scanned once, for all the steps and for `optimize`
+    auto analysis = analyze_alpha(file);
+
+    const bool opaque = is_alpha_all_opaque(tex, analysis);
+
+    auto res     = compute_steps(tex.GetMetadata(), file.get_load_path(), sets, opaque);
+    res.analysis = std::move(analysis);
+    return res;
+}
+
+auto TextureHeader::needs_work() const noexcept -> bool
+{
+    const bool any_step = steps.resize || steps.add_transparent_alpha || steps.mipmaps || steps.convert;
+    return needs_pixels || any_step || steps.best_format != format;
+}
+
+[[nodiscard]] static auto inspect(const TexMetadata &info, const Path &path, const Settings &sets) noexcept
+    -> TextureHeader
+{
+    // Plan for both answers the pixels could give. When they agree, the pixels are not needed.
+    auto steps              = compute_steps(info, path, sets, /*opaque_alpha=*/false);
+    const bool needs_pixels = DirectX::HasAlpha(info.format)
+                              && steps != compute_steps(info, path, sets, /*opaque_alpha=*/true);
+
+    return TextureHeader{
+        .dimension    = Dimension{.w = info.width, .h = info.height},
+        .format       = info.format,
+        .mip_count    = info.mipLevels,
+        .cubemap      = info.IsCubemap(),
+        .steps        = std::move(steps),
+        .needs_pixels = needs_pixels,
+    };
+}
+
+auto inspect(const Path &path, const Settings &sets) noexcept -> tl::expected<TextureHeader, Error>
+{
+    TexMetadata info{};
+    const auto wpath = path.wstring();
+    auto hr          = GetMetadataFromDDSFile(wpath.c_str(), DirectX::DDS_FLAGS_NONE, info);
+    if (FAILED(hr))
+    {
+        // Maybe it's a TGA then?
+        const auto hr2 = GetMetadataFromTGAFile(wpath.c_str(), DirectX::TGA_FLAGS_NONE, info);
+        if (FAILED(hr2))
+            return tl::make_unexpected(error_from_hresult(hr)); // preserve original error
+    }
+    return inspect(info, path, sets);
+}
+
+auto inspect(const Path &relative_path, std::span<const std::byte> data, const Settings &sets) noexcept
+    -> tl::expected<TextureHeader, Error>
+{
+    TexMetadata info{};
+    const auto hr = GetMetadataFromDDSMemory(data.data(), data.size(), DirectX::DDS_FLAGS_NONE, info);
+    if (FAILED(hr))
+    {
+        // Maybe it's a TGA then?
+        const auto hr2 = GetMetadataFromTGAMemory(data.data(), data.size(), DirectX::TGA_FLAGS_NONE, info);
+        if (FAILED(hr2))
+            return tl::make_unexpected(error_from_hresult(hr)); // preserve original error
+    }
+    return inspect(info, relative_path, sets);
+}
+
 auto compute_optimization_steps(const CrunchTexture &file, const Settings &sets) noexcept -> OptimizationSteps
 {
     const auto &tex = file.get();
@@ -250,6 +402,8 @@ auto compute_optimization_steps(const CrunchTexture &file, const Settings &sets)
         res.convert = true;
 
     res.best_format = best_output_format(file, sets, /*force_alpha=*/false);
+    res.quality     = sets.quality;
+    res.bc_encoder  = sets.bc_encoder;
 
     return res;
 }
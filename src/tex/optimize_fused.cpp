@@ -0,0 +1,488 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/tex/compression_device.hpp"
+#include "btu/tex/functions.hpp"
+#include "btu/tex/optimize.hpp"
+#include "btu/tex/texture.hpp"
+
+#include <btu/common/buffer_pool.hpp>
+#include <btu/tex/detail/compress_bc7.hpp>
+#include <btu/tex/detail/compress_bcn.hpp>
+#include <btu/tex/detail/decompress_bcn.hpp>
+#include <btu/tex/dxtex.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace btu::tex {
+namespace {
+/// Every intermediate row is RGBA8
+constexpr size_t k_channels = 4;
+/// Rows decoded or encoded at once. Even, and a multiple of the block size.
+constexpr size_t k_strip_rows = 64;
+
+// Scratch buffers are recycled from one texture to the next processed on the same thread
+using Bytes  = common::BufferPool<uint8_t>;
+using Floats = common::BufferPool<float>;
+
+[[nodiscard]] auto is_fused_source_format(DXGI_FORMAT format) noexcept -> bool
+{
+    switch (format)
+    {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC7_UNORM: return true;
+        default: return false;
+    }
+}
+
+[[nodiscard]] auto is_fused_output_format(DXGI_FORMAT format) noexcept -> bool
+{
+    switch (format)
+    {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC7_UNORM: return true;
+        default: return false;
+    }
+}
+
+/// Mirrors the choice made by `optimize`: compressed textures are always converted
+[[nodiscard]] auto fused_output_format(const TexMetadata &info, const OptimizationSteps &sets) noexcept
+    -> DXGI_FORMAT
+{
+    const auto should_convert = sets.convert || DirectX::IsCompressed(info.format)
+                                || !DirectX::HasAlpha(sets.best_format);
+    return should_convert ? sets.best_format : info.format;
+}
+
+/// Reads the top mip of an image row by row, as RGBA8. Compressed images are decoded a strip at a time.
+class SourceReader
+{
+public:
+    explicit SourceReader(const Image &image)
+        : image_(image)
+        , row_(Bytes::local().acquire(image.width * k_channels))
+    {
+        if (DirectX::IsCompressed(image.format))
+            strip_ = Bytes::local().acquire(image.width * k_channels * k_strip_rows);
+    }
+
+    /// Rows must be read in order
+    [[nodiscard]] auto row(size_t y) -> tl::expected<const uint8_t *, Error>
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const auto *src = image_.pixels + y * image_.rowPitch;
+        switch (image_.format)
+        {
+            case DXGI_FORMAT_R8G8B8A8_UNORM: return src;
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+            {
+                const bool opaque = image_.format == DXGI_FORMAT_B8G8R8X8_UNORM;
+                for (size_t x = 0; x < row_.size(); x += k_channels)
+                {
+                    row_[x]     = src[x + 2];
+                    row_[x + 1] = src[x + 1];
+                    row_[x + 2] = src[x];
+                    row_[x + 3] = opaque ? 0xFF : src[x + 3];
+                }
+                return row_.data();
+            }
+            default: break;
+        }
+
+        if (y >= strip_begin_ + strip_rows_)
+        {
+            strip_begin_ = y - y % k_strip_rows;
+            strip_rows_  = std::min(k_strip_rows, image_.height - strip_begin_);
+
+            auto strip       = image_;
+            strip.height     = strip_rows_;
+            strip.pixels     = image_.pixels + strip_begin_ / 4 * image_.rowPitch;
+            strip.slicePitch = (strip_rows_ + 3) / 4 * image_.rowPitch;
+
+            const auto decoded = Image{
+                .width      = image_.width,
+                .height     = strip_rows_,
+                .format     = DXGI_FORMAT_R8G8B8A8_UNORM,
+                .rowPitch   = image_.width * k_channels,
+                .slicePitch = image_.width * k_channels * strip_rows_,
+                .pixels     = strip_.data(),
+            };
+            detail::decompress_bcn({&strip, 1}, {&decoded, 1});
+        }
+        return strip_.data() + (y - strip_begin_) * image_.width * k_channels;
+        // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    }
+
+private:
+    Image image_;
+    Bytes::Buffer row_;
+
+    Bytes::Buffer strip_;
+    size_t strip_begin_ = 0;
+    size_t strip_rows_  = 0;
+};
+
+/**
+ * \brief Downscales an image fed row by row, with an area filter: each output pixel is the average of the
+ * source pixels it covers.
+ *
+ * Positions are scaled so that the pixel boundaries of both images are integers: a source pixel is `target`
+ * units wide, and an output pixel is `source` units wide.
+ */
+class Downscaler
+{
+public:
+    Downscaler(Dimension source, Dimension target)
+        : source_(source)
+        , target_(target)
+        , row_(Floats::local().acquire(target.w * k_channels))
+        , sum_(Floats::local().acquire(target.w * k_channels))
+        , out_(Bytes::local().acquire(target.w * k_channels))
+    {
+        std::ranges::fill(sum_, 0.F);
+        for (size_t x = 0; x < target.w; ++x)
+        {
+            const auto begin = x * source.w;
+            const auto end   = begin + source.w;
+            for (size_t sx = begin / target.w; sx * target.w < end; ++sx)
+            {
+                const auto overlap = std::min(end, (sx + 1) * target.w) - std::max(begin, sx * target.w);
+                taps_.push_back(Tap{.source = sx,
+                                    .target = x,
+                                    .weight = static_cast<float>(overlap) / static_cast<float>(source.w)});
+            }
+        }
+    }
+
+    /// Adds the next source row. `emit` is called with each completed output row.
+    template<class Emit>
+    [[nodiscard]] auto push(const uint8_t *source_row, Emit &&emit) -> ResultError
+    {
+        std::ranges::fill(row_, 0.F);
+        for (const auto &tap : taps_)
+            for (size_t c = 0; c < k_channels; ++c)
+                row_[tap.target * k_channels + c] += tap.weight * source_row[tap.source * k_channels + c];
+
+        const auto begin = next_row_ * target_.h;
+        const auto end   = begin + target_.h;
+        ++next_row_;
+
+        const auto row_end = (out_row_ + 1) * source_.h;
+        accumulate(std::min(end, row_end) - begin);
+        if (end < row_end)
+            return {};
+
+        const auto res = emit(finish_row());
+        // The source row may straddle two output rows
+        accumulate(end - row_end);
+        return res;
+    }
+
+private:
+    struct Tap
+    {
+        size_t source;
+        size_t target;
+        float weight;
+    };
+
+    void accumulate(size_t units) noexcept
+    {
+        const auto weight = static_cast<float>(units) / static_cast<float>(source_.h);
+        for (size_t i = 0; i < sum_.size(); ++i)
+            sum_[i] += weight * row_[i];
+    }
+
+    [[nodiscard]] auto finish_row() noexcept -> uint8_t *
+    {
+        std::ranges::transform(sum_, out_.begin(), [](float v) {
+            return static_cast<uint8_t>(std::clamp(v + 0.5F, 0.F, 255.F));
+        });
+        std::ranges::fill(sum_, 0.F);
+        ++out_row_;
+        return out_.data();
+    }
+
+    Dimension source_;
+    Dimension target_;
+    std::vector<Tap> taps_;
+
+    size_t next_row_ = 0;
+    size_t out_row_  = 0;
+    Floats::Buffer row_;
+    Floats::Buffer sum_;
+    Bytes::Buffer out_;
+};
+
+/**
+ * \brief Writes a texture fed with the rows of its top mip.
+ *
+ * Each mip is computed from the previous one as soon as two of its rows are available, with a box filter.
+ * Only a strip of each mip is kept in memory, and is encoded to the output format once full.
+ */
+class MipChainWriter
+{
+public:
+    MipChainWriter(ScratchImage &dest,
+                   EncodingQuality quality,
+                   BcEncoder encoder,
+                   const std::stop_token &stop)
+        : format_(dest.GetMetadata().format)
+        , quality_(quality)
+        , encoder_(encoder)
+        , stop_(stop)
+    {
+        for (size_t mip = 0; mip < dest.GetMetadata().mipLevels; ++mip)
+        {
+            const auto *image = dest.GetImage(mip, 0, 0);
+            const auto rows   = std::min(k_strip_rows, image->height);
+            levels_.push_back(Level{.dest  = image,
+                                    .strip = Bytes::local().acquire(rows * image->width * k_channels),
+                                    .next  = {}});
+        }
+        for (size_t mip = 0; mip + 1 < levels_.size(); ++mip)
+            levels_[mip].next = Bytes::local().acquire(levels_[mip + 1].dest->width * k_channels);
+    }
+
+    [[nodiscard]] auto push(const uint8_t *row) -> ResultError { return push(0, row); }
+
+private:
+    struct Level
+    {
+        const Image *dest;
+        Bytes::Buffer strip;
+        /// The row of the next mip being computed
+        Bytes::Buffer next;
+        size_t rows = 0;
+    };
+
+    // NOLINTNEXTLINE(misc-no-recursion)
+    [[nodiscard]] auto push(size_t mip, const uint8_t *row) -> ResultError
+    {
+        auto &level      = levels_[mip];
+        const auto width = level.dest->width;
+        const auto y     = level.rows++;
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        auto *stored = level.strip.data() + y % k_strip_rows * width * k_channels;
+        std::copy_n(row, width * k_channels, stored);
+
+        if (mip + 1 < levels_.size() && (level.dest->height == 1 || y % 2 == 1))
+        {
+            // Strips have an even height, so the previous row is in the same strip
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const auto *above = level.dest->height == 1 ? stored : stored - width * k_channels;
+            reduce(above, stored, width, level.next);
+            if (auto res = push(mip + 1, level.next.data()); !res)
+                return res;
+        }
+
+        if (level.rows % k_strip_rows == 0 || level.rows == level.dest->height)
+            return flush(level);
+        return {};
+    }
+
+    static void reduce(const uint8_t *above, const uint8_t *below, size_t width, Bytes::Buffer &out)
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        for (size_t x = 0; x < out.size() / k_channels; ++x)
+        {
+            const auto left  = std::min(2 * x, width - 1) * k_channels;
+            const auto right = std::min(2 * x + 1, width - 1) * k_channels;
+            for (size_t c = 0; c < k_channels; ++c)
+            {
+                const auto sum = above[left + c] + above[right + c] + below[left + c] + below[right + c];
+                out[x * k_channels + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+        // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    }
+
+    [[nodiscard]] auto flush(Level &level) const -> ResultError
+    {
+        if (stop_.stop_requested())
+            return tl::make_unexpected(Error(TextureErr::Cancelled));
+
+        const auto &dest  = *level.dest;
+        const auto pitch  = dest.width * k_channels;
+        const auto first  = (level.rows - 1) / k_strip_rows * k_strip_rows;
+        const auto height = level.rows - first;
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        if (!DirectX::IsCompressed(format_))
+        {
+            for (size_t y = 0; y < height; ++y)
+            {
+                const auto *src = level.strip.data() + y * pitch;
+                auto *dst       = dest.pixels + (first + y) * dest.rowPitch;
+                if (format_ == DXGI_FORMAT_R8G8B8A8_UNORM)
+                {
+                    std::copy_n(src, pitch, dst);
+                    continue;
+                }
+                for (size_t x = 0; x < pitch; x += k_channels)
+                {
+                    dst[x]     = src[x + 2];
+                    dst[x + 1] = src[x + 1];
+                    dst[x + 2] = src[x];
+                    dst[x + 3] = format_ == DXGI_FORMAT_B8G8R8X8_UNORM ? 0xFF : src[x + 3];
+                }
+            }
+            return {};
+        }
+
+        auto *blocks     = dest.pixels + first / 4 * dest.rowPitch;
+        const auto strip = Image{
+            .width      = dest.width,
+            .height     = height,
+            .format     = DXGI_FORMAT_R8G8B8A8_UNORM,
+            .rowPitch   = pitch,
+            .slicePitch = pitch * height,
+            .pixels     = level.strip.data(),
+        };
+
+        const auto image = detail::BlockImage{
+            .pixels    = strip.pixels,
+            .row_pitch = strip.rowPitch,
+            .width     = static_cast<uint32_t>(strip.width),
+            .height    = static_cast<uint32_t>(strip.height),
+            .blocks    = blocks,
+        };
+        if (format_ == DXGI_FORMAT_BC7_UNORM)
+            return detail::convert_bc7({&image, 1}, quality_, stop_);
+        if (const auto bc_format = detail::to_bc_format(format_); bc_format && encoder_ == BcEncoder::Builtin)
+            return detail::convert_bcn({&image, 1}, *bc_format, quality_, stop_);
+
+        const auto flags = compression_flags(format_, quality_);
+
+        ScratchImage compressed;
+        const auto hr = Compress(strip, format_, flags, DirectX::TEX_THRESHOLD_DEFAULT, compressed);
+        if (FAILED(hr))
+            return tl::make_unexpected(error_from_hresult(hr));
+
+        std::copy_n(compressed.GetPixels(), (height + 3) / 4 * dest.rowPitch, blocks);
+        return {};
+        // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    }
+
+    DXGI_FORMAT format_;
+    EncodingQuality quality_;
+    BcEncoder encoder_;
+    std::stop_token stop_;
+    std::vector<Level> levels_;
+};
+} // namespace
+
+auto can_optimize_fused(const Texture &file,
+                        const OptimizationSteps &sets,
+                        const CompressionDevice &dev) noexcept -> bool
+{
+    const auto &info   = file.get().GetMetadata();
+    const auto source  = Dimension{.w = info.width, .h = info.height};
+    const auto target  = sets.resize.value_or(source);
+    const auto format  = fused_output_format(info, sets);
+    const bool is_2d   = info.dimension == DirectX::TEX_DIMENSION_TEXTURE2D && info.arraySize == 1
+                       && info.depth == 1 && !info.IsCubemap();
+    const bool shrinks = target.w <= source.w && target.h <= source.h;
+    // Box filtered mips need each size to be exactly halved
+    const bool mips_ok = !sets.mipmaps || (util::is_pow2(target.w) && util::is_pow2(target.h));
+    // Existing mips are only kept by the step-by-step path
+    const bool drops_mips = sets.mipmaps || sets.resize || info.mipLevels == 1;
+    // The step-by-step path downscales by dropping the top mips, and transcodes blocks without decoding them
+    const bool keeps_mips = sets.resize && droppable_mips(info, *sets.resize);
+    const bool transcodes = !sets.resize && !sets.mipmaps && !sets.add_transparent_alpha
+                            && can_transcode(file, format);
+    // The GPU encoder works on whole images
+    const bool gpu_bc7 = format == DXGI_FORMAT_BC7_UNORM && !dev.list_adapters().empty();
+    // `make_transparent_alpha` fails on formats without alpha, let the step-by-step path report it
+    const bool alpha_ok = !sets.add_transparent_alpha || DirectX::HasAlpha(info.format);
+
+    return is_2d && shrinks && mips_ok && drops_mips && !keeps_mips && !transcodes && !gpu_bc7 && alpha_ok
+           && is_fused_source_format(info.format) && is_fused_output_format(format);
+}
+
+auto optimize_fused(Texture &&file,
+                    OptimizationSteps sets,
+                    CompressionDevice &dev,
+                    const std::stop_token &stop) noexcept -> Result
+{
+    if (!can_optimize_fused(file, sets, dev))
+        return optimize(std::move(file), sets, dev, stop);
+
+    try
+    {
+        const auto &info  = file.get().GetMetadata();
+        const auto source = Dimension{.w = info.width, .h = info.height};
+        const auto target = sets.resize.value_or(source);
+
+        auto out_info      = info;
+        out_info.width     = target.w;
+        out_info.height    = target.h;
+        out_info.mipLevels = sets.mipmaps ? optimal_mip_count(target) : 1;
+        out_info.format    = fused_output_format(info, sets);
+
+        ScratchImage out;
+        if (const auto hr = out.Initialize(out_info); FAILED(hr))
+            return tl::make_unexpected(error_from_hresult(hr));
+
+        auto reader = SourceReader(*file.get().GetImage(0, 0, 0));
+        auto writer = MipChainWriter(out, sets.quality, sets.bc_encoder, stop);
+
+        bool opaque = true;
+        auto row    = Bytes::local().acquire(target.w * k_channels);
+        auto emit   = [&](const uint8_t *pixels) {
+            std::copy_n(pixels, row.size(), row.begin());
+            for (size_t x = 3; x < row.size(); x += k_channels)
+            {
+                if (sets.add_transparent_alpha)
+                    row[x] = 0;
+                opaque = opaque && row[x] == 0xFF;
+            }
+            return writer.push(row.data());
+        };
+
+        auto scaler = std::optional<Downscaler>{};
+        if (source != target)
+            scaler.emplace(source, target);
+        for (size_t y = 0; y < source.h; ++y)
+        {
+            const auto pixels = reader.row(y);
+            if (!pixels)
+                return tl::make_unexpected(pixels.error());
+
+            const auto res = scaler ? scaler->push(*pixels, emit) : emit(*pixels);
+            if (!res)
+                return tl::make_unexpected(res.error());
+        }
+
+        // Same safety check as `optimize`: make sure we don't remove the alpha
+        if (!DirectX::HasAlpha(out_info.format) && !opaque)
+            return tl::make_unexpected(Error(TextureErr::BadInput));
+
+        file.set(std::move(out));
+        return std::move(file);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return tl::make_unexpected(error_from_hresult(E_OUTOFMEMORY));
+    }
+}
+} // namespace btu::tex
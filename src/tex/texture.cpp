@@ -159,4 +159,37 @@ auto save(const Texture &tex) noexcept -> tl::expected<std::vector<std::byte>, E
                        reinterpret_cast<std::byte *>(blob.GetBufferPointer()) + blob.GetBufferSize());
     // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
 }
+
+auto estimate_memory_usage(const TexMetadata &info) noexcept -> size_t
+{
+    // Decompression, resizing and mipmap generation each allocate a new image while the previous one is
+    // still alive, and DirectXTex adds its own scratch rows on top. Three RGBA8 copies is a good upper bound.
+    constexpr size_t k_bytes_per_pixel = 4;
+    constexpr size_t k_live_copies     = 3;
+
+    size_t pixels = 0;
+    for (size_t mip = 0; mip < std::max<size_t>(info.mipLevels, 1); ++mip)
+    {
+        const auto w = std::max<size_t>(info.width >> mip, 1);
+        const auto h = std::max<size_t>(info.height >> mip, 1);
+        const auto d = std::max<size_t>(info.depth >> mip, 1);
+        pixels += w * h * d;
+    }
+    return pixels * std::max<size_t>(info.arraySize, 1) * k_bytes_per_pixel * k_live_copies;
+}
+
+auto estimate_memory_usage(const Path &path) noexcept -> tl::expected<size_t, Error>
+{
+    TexMetadata info{};
+    const auto wpath = path.wstring();
+    auto hr          = GetMetadataFromDDSFile(wpath.c_str(), DirectX::DDS_FLAGS_NONE, info);
+    if (FAILED(hr))
+    {
+        // Maybe it's a TGA then?
+        const auto hr2 = GetMetadataFromTGAFile(wpath.c_str(), DirectX::TGA_FLAGS_NONE, info);
+        if (FAILED(hr2))
+            return tl::make_unexpected(error_from_hresult(hr)); // preserve original error
+    }
+    return estimate_memory_usage(info);
+}
 } // namespace btu::tex
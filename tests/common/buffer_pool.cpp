@@ -0,0 +1,79 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/common/buffer_pool.hpp"
+
+#include <catch.hpp>
+
+#include <thread>
+
+TEST_CASE("BufferPool", "[src]")
+{
+    using Pool = btu::common::BufferPool<int>;
+    auto pool  = Pool{};
+
+    SECTION("released buffers are reused")
+    {
+        const int *data = nullptr;
+        {
+            auto buf = pool.acquire(100);
+            CHECK(buf.size() == 100);
+            data = buf.data();
+        }
+        CHECK(pool.pooled_bytes() >= 100 * sizeof(int));
+
+        const auto smaller = pool.acquire(50);
+        CHECK(smaller.size() == 50);
+        CHECK(smaller.data() == data);
+        CHECK(pool.pooled_bytes() == 0);
+    }
+    SECTION("the smallest large enough buffer is picked")
+    {
+        {
+            auto small = pool.acquire(10);
+            auto large = pool.acquire(1000);
+        }
+        const auto buf = pool.acquire(5);
+        CHECK(pool.pooled_bytes() >= 1000 * sizeof(int));
+    }
+    SECTION("moved buffers are released once")
+    {
+        {
+            auto buf   = pool.acquire(10);
+            auto moved = std::move(buf);
+            buf        = std::move(moved);
+        }
+        const auto first  = pool.acquire(10);
+        const auto second = pool.acquire(10);
+        CHECK(first.data() != second.data());
+        CHECK(pool.pooled_bytes() == 0);
+    }
+    SECTION("memory kept is bounded")
+    {
+        {
+            auto buffers = std::vector<Pool::Buffer>{};
+            for (size_t i = 0; i < Pool::k_max_buffers * 2; ++i)
+                buffers.push_back(pool.acquire(i + 1));
+        }
+        CHECK(pool.pooled_bytes() <= Pool::k_max_bytes);
+
+        pool.clear();
+        CHECK(pool.pooled_bytes() == 0);
+    }
+    SECTION("buffers destroyed on another thread are freed")
+    {
+        auto buf = pool.acquire(100);
+        std::thread([&buf] { const auto moved = std::move(buf); }).join();
+        CHECK(pool.pooled_bytes() == 0);
+    }
+    SECTION("each thread has its own pool")
+    {
+        const auto *main_pool = &Pool::local();
+        const Pool *other_pool = nullptr;
+        std::thread([&] { other_pool = &Pool::local(); }).join();
+        CHECK(main_pool != other_pool);
+        CHECK(main_pool == &Pool::local());
+    }
+}
@@ -202,4 +202,57 @@ TEST_CASE("write_file_new", "[src]")
         const auto result = btu::common::write_file_new(file.path(), content);
         CHECK_FALSE(result);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("list_files_mt", "[src]")
+{
+    SECTION("lists the same files as recursive_directory_iterator")
+    {
+        const auto directory = FsTempDir();
+        for (int i = 0; i < 20; ++i)
+        {
+            const auto sub = directory.path() / std::to_string(i % 4) / std::to_string(i % 3);
+            fs::create_directories(sub);
+            create_file(sub / ("file" + std::to_string(i)));
+        }
+        fs::create_directories(directory.path() / "empty");
+        create_file(directory.path() / "root_file");
+
+        auto expected = std::vector<btu::Path>{};
+        for (const auto &entry : fs::recursive_directory_iterator(directory.path()))
+            if (entry.is_regular_file())
+                expected.emplace_back(entry.path());
+
+        auto result = btu::common::list_files_mt(directory.path());
+
+        std::ranges::sort(expected);
+        std::ranges::sort(result);
+        CHECK(result == expected);
+        CHECK(result.size() == 21);
+    }
+    SECTION("directory does not exist")
+    {
+        CHECK(btu::common::list_files_mt("invalid_path").empty());
+    }
+}
+
+TEST_CASE("MappedFile", "[src]")
+{
+    SECTION("maps the whole file")
+    {
+        const auto file    = FsTempFile("some content");
+        const auto content = require_expected(btu::common::read_file(file.path()));
+        const auto mapped  = require_expected(btu::common::MappedFile::open(file.path()));
+        CHECK(std::ranges::equal(mapped.data(), content));
+    }
+    SECTION("empty file")
+    {
+        const auto file   = FsTempFile();
+        const auto mapped = require_expected(btu::common::MappedFile::open(file.path()));
+        CHECK(mapped.data().empty());
+    }
+    SECTION("invalid path has error")
+    {
+        CHECK_FALSE(btu::common::MappedFile::open("invalid_path").has_value());
+    }
+}
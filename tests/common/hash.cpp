@@ -0,0 +1,29 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/common/hash.hpp"
+
+#include <catch.hpp>
+
+TEST_CASE("hash", "[src]")
+{
+    using btu::common::hash, btu::common::Hasher;
+
+    SECTION("Matches FNV-1a reference values")
+    {
+        STATIC_REQUIRE(hash(std::string_view{}) == 0xcbf2'9ce4'8422'2325);
+        STATIC_REQUIRE(hash(std::string_view{"a"}) == 0xaf63'dc4c'8601'ec8c);
+        STATIC_REQUIRE(hash(std::string_view{"foobar"}) == 0x8594'4171'f739'67e8);
+    }
+    SECTION("Streaming is the same as hashing at once")
+    {
+        STATIC_REQUIRE(Hasher{}.update(std::string_view{"foo"}).update(std::string_view{"bar"}).digest()
+                       == hash(std::string_view{"foobar"}));
+    }
+    SECTION("Integers are hashed as little endian")
+    {
+        STATIC_REQUIRE(Hasher{}.update(std::uint16_t{0x6261}).digest() == hash(std::string_view{"ab"}));
+    }
+}
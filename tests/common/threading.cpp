@@ -55,3 +55,49 @@ TEST_CASE("make_producer_mt", "[src]")
         CHECK(result.size() == input.size());
     }
 }
+
+TEST_CASE("MemoryBudget", "[src]")
+{
+    using btu::common::MemoryBudget;
+
+    SECTION("admits jobs while they fit")
+    {
+        auto budget = MemoryBudget{100};
+        CHECK(budget.try_acquire(60));
+        CHECK(budget.try_acquire(40));
+        CHECK_FALSE(budget.try_acquire(1));
+        CHECK(budget.used() == 100);
+
+        budget.release(40);
+        CHECK(budget.try_acquire(30));
+        CHECK(budget.used() == 90);
+    }
+    SECTION("admits a job larger than the budget when nothing else runs")
+    {
+        auto budget = MemoryBudget{100};
+        CHECK(budget.try_acquire(1000));
+        CHECK_FALSE(budget.try_acquire(1));
+
+        budget.release(1000);
+        CHECK(budget.used() == 0);
+    }
+    SECTION("acquire waits for a release")
+    {
+        auto budget = MemoryBudget{100};
+        REQUIRE(budget.try_acquire(80));
+
+        auto acquired = std::atomic_bool{false};
+        auto thread   = std::jthread([&] {
+            budget.acquire(50);
+            acquired = true;
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK_FALSE(acquired);
+
+        budget.release(80);
+        thread.join();
+        CHECK(acquired);
+        CHECK(budget.used() == 50);
+    }
+}
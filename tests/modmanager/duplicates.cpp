@@ -0,0 +1,72 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/duplicates.hpp"
+
+#include <btu/common/filesystem.hpp>
+
+#include "../utils.hpp"
+
+TEST_CASE("Duplicate detection", "[src]")
+{
+    const auto dir  = TempPath{btu::fs::temp_directory_path()};
+    const auto mod1 = dir.path() / "mod1";
+    const auto mod2 = dir.path() / "mod2";
+    btu::fs::create_directories(mod1 / "textures");
+    btu::fs::create_directories(mod2 / "textures");
+
+    // Same start, but different content, to go past the partial hash
+    const auto large = std::string(btu::modmanager::k_partial_hash_size * 2, 'x');
+    create_file(mod1 / "textures" / "a.dds", large);
+    create_file(mod2 / "textures" / "a.dds", large);
+    create_file(mod2 / "textures" / "b.dds", large.substr(1) + 'y');
+
+    create_file(mod1 / "small.txt", "abc");
+    create_file(mod2 / "small.txt", "abc");
+    create_file(mod2 / "other.txt", "abd");
+
+    create_file(mod1 / "empty.txt");
+    create_file(mod2 / "empty.txt");
+
+    const auto dirs   = std::vector{mod1, mod2};
+    const auto groups = btu::modmanager::find_duplicates(dirs);
+    REQUIRE(groups.size() == 2);
+
+    CHECK(groups[0].size == large.size());
+    CHECK(groups[0].files == std::vector{mod1 / "textures" / "a.dds", mod2 / "textures" / "a.dds"});
+    CHECK(groups[0].wasted_bytes() == large.size());
+    CHECK(groups[1].files == std::vector{mod1 / "small.txt", mod2 / "small.txt"});
+
+    SECTION("small files can be ignored")
+    {
+        CHECK(btu::modmanager::find_duplicates(dirs, 4).size() == 1);
+    }
+    SECTION("overlapping directories do not report a file twice")
+    {
+        const auto overlapping = std::vector{dir.path(), mod1};
+        CHECK(btu::modmanager::find_duplicates(overlapping) == groups);
+    }
+    SECTION("duplicates are replaced with hard links")
+    {
+        const auto report = btu::modmanager::hard_link_duplicates(groups);
+        CHECK(report.failures.empty());
+        CHECK(report.linked_files == 2);
+        CHECK(report.saved_bytes == large.size() + 3);
+
+        CHECK(btu::fs::equivalent(mod1 / "textures" / "a.dds", mod2 / "textures" / "a.dds"));
+        CHECK(btu::fs::equivalent(mod1 / "small.txt", mod2 / "small.txt"));
+        CHECK(btu::common::compare_files(mod2 / "small.txt", mod2 / "other.txt") == false);
+
+        // Already linked files are skipped
+        CHECK(btu::modmanager::hard_link_duplicates(groups).linked_files == 0);
+    }
+    SECTION("files changed since the scan are left untouched")
+    {
+        create_file(mod2 / "small.txt", "abz");
+        const auto report = btu::modmanager::hard_link_duplicates(groups);
+        CHECK(report.linked_files == 1);
+        CHECK_FALSE(btu::fs::equivalent(mod1 / "small.txt", mod2 / "small.txt"));
+    }
+}
@@ -0,0 +1,57 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/manifest.hpp"
+
+#include "../utils.hpp"
+
+using btu::modmanager::Manifest, btu::modmanager::FileState, btu::modmanager::ArchiveEntryState;
+
+TEST_CASE("Manifest", "[src]")
+{
+    const auto dir = TempPath{"."};
+    btu::fs::create_directories(dir.path());
+    const auto path = dir.path() / "manifest.json";
+
+    const auto file_state  = FileState{.size = 1, .mtime = 2, .content_hash = 3, .settings_hash = 4};
+    const auto entry_state = ArchiveEntryState{.size = 5, .content_hash = 6, .settings_hash = 7};
+
+    SECTION("Save and load")
+    {
+        {
+            auto manifest = Manifest{path};
+            manifest.set_file("a/b.nif", file_state);
+            const auto entries = std::to_array({std::pair{Path{"textures/c.dds"}, entry_state}});
+            manifest.set_archive("d.bsa", file_state, entries);
+            require_expected(manifest.save());
+        }
+
+        const auto manifest = Manifest{path};
+        CHECK(manifest.file("a/b.nif") == file_state);
+        CHECK(manifest.file("d.bsa") == file_state);
+        CHECK(manifest.archive_entry("d.bsa", "textures/c.dds") == entry_state);
+        CHECK_FALSE(manifest.file("missing.nif").has_value());
+        CHECK_FALSE(manifest.archive_entry("d.bsa", "missing.dds").has_value());
+    }
+    SECTION("Setting an archive forgets its previous entries")
+    {
+        auto manifest = Manifest{path};
+        manifest.set_archive("d.bsa", file_state, std::to_array({std::pair{Path{"old.dds"}, entry_state}}));
+        manifest.set_archive("d.bsa", file_state, std::to_array({std::pair{Path{"new.dds"}, entry_state}}));
+
+        CHECK_FALSE(manifest.archive_entry("d.bsa", "old.dds").has_value());
+        CHECK(manifest.archive_entry("d.bsa", "new.dds") == entry_state);
+
+        manifest.remove_file("d.bsa");
+        CHECK_FALSE(manifest.file("d.bsa").has_value());
+        CHECK_FALSE(manifest.archive_entry("d.bsa", "new.dds").has_value());
+    }
+    SECTION("A corrupted manifest is ignored")
+    {
+        create_file(path, "{ not json");
+        const auto manifest = Manifest{path};
+        CHECK_FALSE(manifest.file("a/b.nif").has_value());
+    }
+}
@@ -0,0 +1,76 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/mod_batch.hpp"
+
+#include "../utils.hpp"
+
+#include <atomic>
+
+namespace {
+/// Appends a byte to every file, and counts them
+class AppendTransformer final : public btu::modmanager::ModFolderTransformer
+{
+public:
+    [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                         ArchiveTooLargeState /*state*/) noexcept
+        -> ArchiveTooLargeAction override
+    {
+        return ArchiveTooLargeAction::Skip;
+    }
+
+    [[nodiscard]] auto transform_file(const btu::modmanager::ModFile file) noexcept
+        -> std::optional<std::vector<std::byte>> override
+    {
+        count += 1;
+        auto content = require_expected(*file.content);
+        content.push_back(std::byte{'!'});
+        return content;
+    }
+
+    std::atomic<size_t> count = 0;
+};
+} // namespace
+
+TEST_CASE("ModBatch", "[src]")
+{
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    for (const auto *mod : {"mod1", "mod2", "mod3", "some_separator"})
+        btu::fs::create_directories(dir.path() / mod);
+    create_file(dir.path() / "mod1" / "meta.ini");
+    create_file(dir.path() / "mod2" / "meta.ini");
+    create_file(dir.path() / "mod3" / "meta.ini");
+    create_file(dir.path() / "mod1" / "a.txt", "a");
+    create_file(dir.path() / "mod2" / "b.txt", "b");
+
+    auto batch = btu::modmanager::ModBatch(btu::bsa::Settings::get(btu::Game::SSE));
+    CHECK(batch.add_mods_directory(dir.path()) == btu::modmanager::ModManager::MO2);
+    REQUIRE(batch.mods().size() == 3);
+    CHECK(batch.mods().front().path() == dir.path() / "mod1");
+
+    SECTION("each mod gets its own transformer")
+    {
+        auto counts = btu::common::synchronized<std::map<std::u8string, size_t>>{};
+        batch.set_concurrent_mods(2);
+        batch.transform([](auto &) { return std::make_unique<AppendTransformer>(); },
+                        [&](auto &mod, auto &transformer) {
+                            const auto count = dynamic_cast<AppendTransformer &>(transformer).count.load();
+                            counts.wlock()->emplace(mod.name(), count);
+                        });
+
+        const auto expected = std::map<std::u8string, size_t>{{u8"mod1", 2}, {u8"mod2", 2}, {u8"mod3", 1}};
+        CHECK(*counts.rlock() == expected);
+        CHECK(require_expected(btu::common::read_file(dir.path() / "mod1" / "a.txt")).size() == 2);
+        CHECK(require_expected(btu::common::read_file(dir.path() / "mod2" / "b.txt")).size() == 2);
+    }
+    SECTION("no mod is started once a stop is requested")
+    {
+        batch.request_stop();
+        batch.transform([](auto &) {
+            FAIL("No mod should be started");
+            return std::unique_ptr<btu::modmanager::ModFolderTransformer>{};
+        });
+    }
+}
@@ -11,6 +11,11 @@
 #include <binary_io/memory_stream.hpp>
 #include <btu/hkx/anim.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <thread>
+
 class Iterator final : public btu::modmanager::ModFolderIterator
 {
     Path out_dir_;
@@ -107,6 +112,39 @@ TEST_CASE("ModFolder size", "[src]")
     CHECK(mf.size() == 4);
 }
 
+TEST_CASE("ModFolder census", "[src]")
+{
+    using btu::modmanager::FileStats;
+
+    SECTION("loose files")
+    {
+        const auto dir = TempPath{btu::fs::temp_directory_path()};
+        btu::fs::create_directories(dir.path() / "meshes");
+        create_file(dir.path() / "meshes" / "a.nif", "12");
+        create_file(dir.path() / "meshes" / "b.NIF", "345");
+        create_file(dir.path() / "readme.txt", "6");
+
+        auto mf = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+        const auto census = mf.census();
+
+        CHECK(census.loose == FileStats{.count = 3, .bytes = 6});
+        CHECK(census.archives.count == 0);
+        CHECK(census.extensions.at(u8".nif") == FileStats{.count = 2, .bytes = 5});
+        CHECK(census.extensions.at(u8".txt") == FileStats{.count = 1, .bytes = 1});
+    }
+    SECTION("archived files are counted from the index")
+    {
+        const Path dir    = "modfolder";
+        const auto sets   = btu::bsa::Settings::get(btu::Game::FO4);
+        auto mf           = btu::modmanager::ModFolder(dir / "input", sets);
+        const auto census = mf.census();
+
+        CHECK(census.files().count == 4);
+        CHECK(census.archives.count > 0);
+        CHECK(census.unreadable_archives.empty());
+    }
+}
+
 class IteratorWithArchiveTooLarge final : public btu::modmanager::ModFolderIterator
 {
     bool called_ = false;
@@ -188,4 +226,503 @@ TEST_CASE("ModFolder transform does not remove the archive it just written becau
     mf.transform(transformer);
 
     CHECK(exists(out / "expected_fo4.ba2"));
-}
\ No newline at end of file
+}
+
+class CountingTransformer final : public btu::modmanager::ModFolderTransformer
+{
+public:
+    /// \param stop_after Number of files after which a stop is requested
+    explicit CountingTransformer(std::optional<size_t> stop_after = std::nullopt)
+        : stop_after_(stop_after)
+    {
+    }
+
+    [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                         ArchiveTooLargeState /*state*/) noexcept
+        -> ArchiveTooLargeAction override
+    {
+        return ArchiveTooLargeAction::Process;
+    }
+
+    [[nodiscard]] auto transform_file(const btu::modmanager::ModFile file) noexcept
+        -> std::optional<std::vector<std::byte>> override
+    {
+        count_ += 1;
+        transformed_.wlock()->emplace_back(file.relative_path);
+        auto content   = require_expected(*file.content);
+        content.back() = std::byte{'0'};
+        return content;
+    }
+
+    [[nodiscard]] auto stop_requested() const noexcept -> bool override
+    {
+        return stop_after_ && count_ >= *stop_after_;
+    }
+
+    [[nodiscard]] auto settings_hash() const noexcept -> std::optional<std::uint64_t> override { return 42; }
+    [[nodiscard]] auto id() const noexcept -> std::optional<std::u8string> override { return u8"counting"; }
+
+    [[nodiscard]] auto count() const noexcept -> size_t { return count_; }
+    /// Files given to `transform_file`, in call order
+    [[nodiscard]] auto transformed() const noexcept -> std::vector<Path> { return *transformed_.rlock(); }
+
+private:
+    std::optional<size_t> stop_after_;
+    std::atomic<size_t> count_ = 0;
+    btu::common::synchronized<std::vector<Path>> transformed_;
+};
+
+TEST_CASE("ModFolder transform with a manifest skips unchanged files", "[src]")
+{
+    const Path dir      = "modfolder_transform";
+    const Path out      = dir / "output_manifest";
+    const Path manifest = dir / "manifest.json";
+    btu::fs::remove_all(out);
+    btu::fs::remove(manifest);
+    btu::fs::copy(dir / "input", out);
+
+    const auto transform = [&] {
+        auto mf = btu::modmanager::ModFolder(out, btu::bsa::Settings::get(btu::Game::SSE));
+        mf.use_manifest(manifest);
+        auto transformer = CountingTransformer{};
+        mf.transform(transformer);
+        return transformer.count();
+    };
+
+    CHECK(transform() > 0);
+    CHECK(btu::fs::exists(manifest));
+    CHECK(btu::common::compare_directories(out, dir / "expected"));
+
+    // Nothing changed
+    CHECK(transform() == 0);
+
+    // Only the new file is transformed
+    create_file(out / "new_file.txt", "new content");
+    CHECK(transform() == 1);
+    CHECK(transform() == 0);
+}
+
+TEST_CASE("ModFolder transform only skips its own manifest", "[src]")
+{
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    btu::fs::create_directories(dir.path());
+    // Shares the name of the manifest, but belongs to the mod
+    create_file(dir.path() / "manifest.json.txt", "user file");
+
+    const auto transform = [&] {
+        auto mf = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+        mf.use_manifest(dir.path() / "manifest.json");
+        auto transformer = CountingTransformer{};
+        mf.transform(transformer);
+        return transformer.count();
+    };
+
+    CHECK(transform() == 1);
+    // The manifest, now saved in the folder, is not processed
+    CHECK(transform() == 0);
+}
+
+TEST_CASE("ModFolder transform processes each file once, even though it writes into the folder", "[src]")
+{
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    btu::fs::create_directories(dir.path());
+
+    auto expected                 = std::vector<Path>{};
+    constexpr size_t k_file_count = 64;
+    for (size_t i = 0; i < k_file_count; ++i)
+    {
+        create_file(dir.path() / std::to_string(i), "content");
+        expected.emplace_back(std::to_string(i));
+    }
+
+    // Written back as `mod.bsa`, as these settings use that extension
+    {
+        constexpr auto version = btu::bsa::ArchiveVersion::sse;
+        constexpr auto type    = btu::bsa::ArchiveType::Standard;
+        auto arch              = btu::bsa::Archive{version, type};
+        for (size_t i = 0; i < 4; ++i)
+        {
+            auto file    = btu::bsa::File(version, type);
+            auto content = std::vector{std::byte{'a'}, std::byte{'b'}, std::byte{'c'}};
+            REQUIRE(file.read(content));
+            const auto name = "meshes/file" + std::to_string(i) + ".txt";
+            REQUIRE(arch.emplace(name, std::move(file)));
+            expected.emplace_back(name);
+        }
+        REQUIRE(std::move(arch).write(dir.path() / "mod.ba2"));
+    }
+
+    // Checkpoints make loose files be written to a temporary file, then renamed
+    auto mf = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+    mf.use_manifest(dir.path() / "manifest.json");
+    mf.enable_checkpoints();
+    auto transformer = CountingTransformer{};
+    mf.transform(transformer);
+
+    auto transformed = transformer.transformed();
+    std::ranges::sort(transformed);
+    std::ranges::sort(expected);
+    CHECK(transformed == expected);
+    CHECK(btu::fs::exists(dir.path() / "mod.bsa"));
+    // The loose files, the archive and the manifest
+    CHECK(btu::common::list_files_mt(dir.path()).size() == k_file_count + 2);
+}
+
+TEST_CASE("ModFolder transform with checkpoints resumes an interrupted run", "[src]")
+{
+    const Path dir        = "modfolder_transform";
+    const Path out        = dir / "output_checkpoints";
+    const Path manifest   = dir / "manifest_checkpoints.json";
+    const Path resume_dir = dir / "manifest_checkpoints.json.resume";
+    const auto reset      = [&] {
+        btu::fs::remove_all(out);
+        btu::fs::remove(manifest);
+        btu::fs::remove_all(resume_dir);
+        btu::fs::copy(dir / "input", out);
+    };
+
+    // Files are transformed one at a time, so that we know which ones were done when the stop was requested
+    auto pool            = btu::common::ThreadPool{1};
+    const auto transform = [&](std::optional<size_t> stop_after) {
+        auto mf = btu::modmanager::ModFolder(out, btu::bsa::Settings::get(btu::Game::SSE));
+        mf.use_thread_pool(pool);
+        mf.use_manifest(manifest);
+        mf.enable_checkpoints(std::chrono::seconds(1));
+        auto transformer = CountingTransformer{stop_after};
+        mf.transform(transformer);
+        return transformer.transformed();
+    };
+
+    reset();
+    const auto total = transform(std::nullopt).size();
+
+    reset();
+    constexpr size_t k_stop_after = 3;
+    REQUIRE(total > k_stop_after);
+    const auto first = transform(k_stop_after);
+    REQUIRE(first.size() == k_stop_after);
+    // Progress is saved even though the run was interrupted
+    CHECK(btu::fs::exists(manifest));
+
+    // The file that requested the stop was still written, so nothing is transformed again
+    const auto second = transform(std::nullopt);
+    CHECK(second.size() == total - k_stop_after);
+    for (const auto &path : first)
+        CHECK(std::ranges::find(second, path) == second.end());
+
+    CHECK(btu::common::compare_directories(out, dir / "expected"));
+    CHECK_FALSE(btu::fs::exists(resume_dir));
+
+    CHECK(transform(std::nullopt).empty());
+}
+
+TEST_CASE("ModFolder transform remembers a file written after a stop was requested", "[src]")
+{
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    btu::fs::create_directories(dir.path());
+    constexpr size_t k_file_count = 8;
+    for (size_t i = 0; i < k_file_count; ++i)
+        create_file(dir.path() / std::to_string(i), "content");
+
+    auto pool            = btu::common::ThreadPool{1};
+    const auto transform = [&](std::optional<size_t> stop_after) {
+        auto mf = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+        mf.use_thread_pool(pool);
+        mf.use_manifest(dir.path() / "manifest.json");
+        auto transformer = CountingTransformer{stop_after};
+        mf.transform(transformer);
+        return transformer.transformed();
+    };
+
+    // The stop is requested by the first file, once it is transformed but before it is written
+    const auto first = transform(1);
+    REQUIRE(first.size() == 1);
+
+    const auto second = transform(std::nullopt);
+    CHECK(second.size() == k_file_count - 1);
+    CHECK(std::ranges::find(second, first.front()) == second.end());
+}
+
+TEST_CASE("ModFolder transform with checkpoints reuses the staged files of an interrupted archive", "[src]")
+{
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    btu::fs::create_directories(dir.path());
+
+    constexpr size_t k_entry_count = 16;
+    {
+        constexpr auto version = btu::bsa::ArchiveVersion::sse;
+        constexpr auto type    = btu::bsa::ArchiveType::Standard;
+        auto arch              = btu::bsa::Archive{version, type};
+        for (size_t i = 0; i < k_entry_count; ++i)
+        {
+            auto file    = btu::bsa::File(version, type);
+            auto content = std::vector{std::byte{'a'}, std::byte{'b'}, std::byte{'c'}};
+            REQUIRE(file.read(content));
+            REQUIRE(arch.emplace("meshes/file" + std::to_string(i) + ".txt", std::move(file)));
+        }
+        REQUIRE(std::move(arch).write(dir.path() / "mod.bsa"));
+    }
+
+    auto pool            = btu::common::ThreadPool{1};
+    const auto transform = [&](std::optional<size_t> stop_after) {
+        auto mf = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+        mf.use_thread_pool(pool);
+        mf.use_manifest(dir.path() / "manifest.json");
+        mf.enable_checkpoints(std::chrono::seconds(1));
+        auto transformer = CountingTransformer{stop_after};
+        mf.transform(transformer);
+        return transformer.transformed();
+    };
+
+    constexpr size_t k_stop_after = 5;
+    const auto first              = transform(k_stop_after);
+    REQUIRE(first.size() == k_stop_after);
+    // The archive was not written, but its transformed files were staged
+    CHECK(btu::fs::exists(dir.path() / "manifest.json.resume"));
+
+    const auto second = transform(std::nullopt);
+    CHECK(second.size() == k_entry_count - k_stop_after);
+    for (const auto &path : first)
+        CHECK(std::ranges::find(second, path) == second.end());
+    CHECK_FALSE(btu::fs::exists(dir.path() / "manifest.json.resume"));
+
+    CHECK(transform(std::nullopt).empty());
+}
+
+TEST_CASE("ModFolder transform does not deadlock on a single thread pool", "[src]")
+{
+    const Path dir = "modfolder_transform";
+    const Path out = dir / "output_single_thread";
+    btu::fs::remove_all(out);
+    btu::fs::copy(dir / "input", out);
+
+    // Archives wait for the tasks of their files, which must still find a worker
+    auto pool = btu::common::ThreadPool{1};
+    auto mf   = btu::modmanager::ModFolder(out, btu::bsa::Settings::get(btu::Game::SSE));
+    mf.use_thread_pool(pool);
+    auto transformer = CountingTransformer{};
+    mf.transform(transformer);
+
+    CHECK(btu::common::compare_directories(out, dir / "expected"));
+}
+
+TEST_CASE("ModFolder transform drives many archives from a bounded pool", "[src]")
+{
+    /// Records the threads that look into archives: `wants_file` is called by the thread driving the archive
+    class DriverTransformer final : public btu::modmanager::ModFolderTransformer
+    {
+    public:
+        [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                             ArchiveTooLargeState /*state*/) noexcept
+            -> ArchiveTooLargeAction override
+        {
+            return ArchiveTooLargeAction::Process;
+        }
+
+        [[nodiscard]] auto wants_file(const Path &relative_path) const noexcept -> bool override
+        {
+            if (relative_path.has_parent_path())
+                drivers_.wlock()->insert(std::this_thread::get_id());
+            return true;
+        }
+
+        [[nodiscard]] auto transform_file(const btu::modmanager::ModFile file) noexcept
+            -> std::optional<std::vector<std::byte>> override
+        {
+            count_ += 1;
+            auto content   = require_expected(*file.content);
+            content.back() = std::byte{'0'};
+            return content;
+        }
+
+        [[nodiscard]] auto count() const noexcept -> size_t { return count_; }
+        [[nodiscard]] auto drivers() const noexcept -> size_t { return drivers_.rlock()->size(); }
+
+    private:
+        std::atomic<size_t> count_ = 0;
+        mutable btu::common::synchronized<std::set<std::thread::id>> drivers_;
+    };
+
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    btu::fs::create_directories(dir.path());
+
+    constexpr size_t k_archive_count = 64;
+    constexpr size_t k_entry_count   = 2;
+    constexpr auto version           = btu::bsa::ArchiveVersion::sse;
+    constexpr auto type              = btu::bsa::ArchiveType::Standard;
+    for (size_t a = 0; a < k_archive_count; ++a)
+    {
+        auto arch = btu::bsa::Archive{version, type};
+        for (size_t i = 0; i < k_entry_count; ++i)
+        {
+            auto file    = btu::bsa::File(version, type);
+            auto content = std::vector{std::byte{'a'}, std::byte{'b'}, std::byte{'c'}};
+            REQUIRE(file.read(content));
+            REQUIRE(arch.emplace("meshes/file" + std::to_string(i) + ".txt", std::move(file)));
+        }
+        REQUIRE(std::move(arch).write(dir.path() / ("mod" + std::to_string(a) + ".bsa")));
+    }
+
+    constexpr size_t k_drivers = 2;
+    auto pool                  = btu::common::ThreadPool{1};
+    auto archive_pool          = btu::common::ThreadPool{k_drivers};
+
+    auto mf = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+    mf.use_thread_pool(pool);
+    mf.use_archive_thread_pool(archive_pool);
+    auto transformer = DriverTransformer{};
+    mf.transform(transformer);
+
+    CHECK(transformer.count() == k_archive_count * k_entry_count);
+    CHECK(transformer.drivers() <= k_drivers);
+}
+
+TEST_CASE("ModFolder transform reuses outputs from the cache", "[src]")
+{
+    const Path dir       = "modfolder_transform";
+    const auto cache_dir = TempPath{dir};
+    auto cache           = btu::modmanager::TransformCache{cache_dir.path()};
+
+    const auto transform = [&](const Path &out) {
+        btu::fs::remove_all(out);
+        btu::fs::copy(dir / "input", out);
+
+        auto mf = btu::modmanager::ModFolder(out, btu::bsa::Settings::get(btu::Game::SSE));
+        mf.use_cache(cache);
+        auto transformer = CountingTransformer{};
+        mf.transform(transformer);
+        return transformer.count();
+    };
+
+    CHECK(transform(dir / "output_cache1") > 0);
+
+    // Same files in another folder: everything comes from the cache
+    CHECK(transform(dir / "output_cache2") == 0);
+    CHECK(btu::common::compare_directories(dir / "output_cache2", dir / "expected"));
+}
+
+TEST_CASE("FileContent", "[src]")
+{
+    using btu::modmanager::FileContent;
+
+    const auto file = TempPath{btu::fs::temp_directory_path()};
+    create_file(file.path(), "some content");
+    const auto expected = require_expected(btu::common::read_file(file.path()));
+
+    SECTION("loose file can be viewed then owned")
+    {
+        const auto content = FileContent::from_file(file.path());
+        CHECK(std::ranges::equal(require_expected(content.view()), expected));
+        CHECK(require_expected(*content) == expected);
+    }
+    SECTION("view of a loaded content does not copy it")
+    {
+        const auto content = FileContent([&] { return FileContent::Result(expected); });
+        const auto view    = require_expected(content.view());
+        CHECK(view.data() == content->value().data());
+    }
+    SECTION("missing file has error")
+    {
+        const auto content = FileContent::from_file("invalid_path");
+        CHECK_FALSE(content.view().has_value());
+        CHECK_FALSE(content->has_value());
+    }
+}
+
+TEST_CASE("ModFolder only processes wanted files", "[src]")
+{
+    class NifIterator final : public btu::modmanager::ModFolderIterator
+    {
+    public:
+        [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                             ArchiveTooLargeState /*state*/) noexcept
+            -> ArchiveTooLargeAction override
+        {
+            return ArchiveTooLargeAction::Skip;
+        }
+
+        [[nodiscard]] auto wants_file(const Path &relative_path) const noexcept -> bool override
+        {
+            return relative_path.extension() == ".nif";
+        }
+
+        void process_file(btu::modmanager::ModFile file) noexcept override
+        {
+            processed_.wlock()->emplace_back(std::move(file.relative_path));
+        }
+
+        [[nodiscard]] auto processed() const noexcept -> std::vector<Path> { return *processed_.rlock(); }
+
+    private:
+        btu::common::synchronized<std::vector<Path>> processed_;
+    };
+
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    btu::fs::create_directories(dir.path() / "meshes");
+    create_file(dir.path() / "meshes" / "a.nif", "nif");
+    create_file(dir.path() / "meshes" / "b.txt", "txt");
+
+    auto mf       = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+    auto iterator = NifIterator{};
+    mf.iterate(iterator);
+
+    CHECK(iterator.processed() == std::vector<Path>{Path("meshes") / "a.nif"});
+}
+
+TEST_CASE("ModFolder transform gives each thread its own context", "[src]")
+{
+    struct Context final : btu::modmanager::WorkerContext
+    {
+        std::thread::id owner = std::this_thread::get_id();
+        size_t files          = 0;
+    };
+
+    class ContextTransformer final : public btu::modmanager::ModFolderTransformer
+    {
+    public:
+        [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                             ArchiveTooLargeState /*state*/) noexcept
+            -> ArchiveTooLargeAction override
+        {
+            return ArchiveTooLargeAction::Skip;
+        }
+
+        [[nodiscard]] auto make_worker_context() const noexcept
+            -> std::unique_ptr<btu::modmanager::WorkerContext> override
+        {
+            created_ += 1;
+            return std::make_unique<Context>();
+        }
+
+        [[nodiscard]] auto transform_file(btu::modmanager::ModFile file) noexcept
+            -> std::optional<std::vector<std::byte>> override
+        {
+            auto *context = file.context<Context>();
+            if (context == nullptr || context->owner != std::this_thread::get_id())
+                wrong_context_ = true;
+            else
+                context->files += 1; // No lock needed, the context is only used by this thread
+            return std::nullopt;
+        }
+
+        [[nodiscard]] auto created() const noexcept -> size_t { return created_; }
+        [[nodiscard]] auto wrong_context() const noexcept -> bool { return wrong_context_; }
+
+    private:
+        mutable std::atomic<size_t> created_ = 0;
+        std::atomic_bool wrong_context_      = false;
+    };
+
+    const auto dir = TempPath{btu::fs::temp_directory_path()};
+    btu::fs::create_directories(dir.path());
+    for (int i = 0; i < 50; ++i)
+        create_file(dir.path() / (std::to_string(i) + ".txt"), "content");
+
+    auto mf          = btu::modmanager::ModFolder(dir.path(), btu::bsa::Settings::get(btu::Game::SSE));
+    auto transformer = ContextTransformer{};
+    mf.transform(transformer);
+
+    CHECK_FALSE(transformer.wrong_context());
+    CHECK(transformer.created() >= 1);
+    CHECK(transformer.created() <= btu::common::hardware_concurrency());
+}
@@ -0,0 +1,104 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/transform_cache.hpp"
+
+#include "../utils.hpp"
+
+#include <thread>
+
+using btu::modmanager::TransformCache, btu::modmanager::CacheKey;
+
+namespace {
+auto as_bytes(std::string_view str) -> std::span<const std::byte>
+{
+    return std::as_bytes(std::span{str.data(), str.size()});
+}
+
+auto make_key(std::uint64_t input_hash) -> CacheKey
+{
+    return CacheKey{
+        .input_hash     = input_hash,
+        .input_size     = 10,
+        .relative_path  = "textures/a.dds",
+        .transformer_id = u8"test",
+        .settings_hash  = 1,
+    };
+}
+} // namespace
+
+TEST_CASE("TransformCache", "[src]")
+{
+    const auto dir = TempPath{"."};
+
+    SECTION("Stores outputs")
+    {
+        auto cache = TransformCache{dir.path()};
+        CHECK_FALSE(cache.find(make_key(1)).has_value());
+
+        cache.store(make_key(1), as_bytes("output"));
+        cache.store(make_key(2), std::nullopt);
+
+        const auto output = cache.find(make_key(1));
+        REQUIRE(output.has_value());
+        REQUIRE(output->content.has_value());
+        CHECK(std::ranges::equal(*output->content, as_bytes("output")));
+
+        const auto unchanged = cache.find(make_key(2));
+        REQUIRE(unchanged.has_value());
+        CHECK_FALSE(unchanged->content.has_value());
+    }
+    SECTION("Every part of the key matters")
+    {
+        auto cache = TransformCache{dir.path()};
+        cache.store(make_key(1), as_bytes("output"));
+
+        auto key           = make_key(1);
+        key.transformer_id = u8"other";
+        CHECK_FALSE(cache.find(key).has_value());
+
+        key               = make_key(1);
+        key.settings_hash = 2;
+        CHECK_FALSE(cache.find(key).has_value());
+
+        key               = make_key(1);
+        key.relative_path = "textures/b.dds";
+        CHECK_FALSE(cache.find(key).has_value());
+
+        // But not the case of the path
+        key               = make_key(1);
+        key.relative_path = "Textures\\A.dds";
+        CHECK(cache.find(key).has_value());
+    }
+    SECTION("Is persistent")
+    {
+        {
+            auto cache = TransformCache{dir.path()};
+            cache.store(make_key(1), as_bytes("output"));
+        }
+        auto cache = TransformCache{dir.path()};
+        CHECK(cache.size() > 0);
+        CHECK(cache.find(make_key(1)).has_value());
+    }
+    SECTION("Evicts the least recently used outputs")
+    {
+        const auto output = std::string(100, 'x');
+
+        // Each entry takes a bit more than 100 bytes, so only two of them fit
+        auto cache = TransformCache{dir.path(), 250};
+        cache.store(make_key(1), as_bytes(output));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cache.store(make_key(2), as_bytes(output));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(cache.find(make_key(1)).has_value()); // 1 is now more recent than 2
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cache.store(make_key(3), as_bytes(output));
+
+        CHECK(cache.size() <= cache.max_size());
+        CHECK(cache.find(make_key(1)).has_value());
+        CHECK_FALSE(cache.find(make_key(2)).has_value());
+        CHECK(cache.find(make_key(3)).has_value());
+    }
+}
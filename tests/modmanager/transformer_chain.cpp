@@ -0,0 +1,189 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "btu/modmanager/transformer_chain.hpp"
+
+#include "../utils.hpp"
+
+namespace {
+using btu::modmanager::FileContent;
+using btu::modmanager::ModFile;
+
+/// Appends a byte to the files with the given extension
+class AppendTransformer final : public btu::modmanager::ModFolderTransformer
+{
+public:
+    AppendTransformer(char byte, Path extension)
+        : byte_(byte)
+        , extension_(std::move(extension))
+    {
+    }
+
+    [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                         ArchiveTooLargeState /*state*/) noexcept
+        -> ArchiveTooLargeAction override
+    {
+        return ArchiveTooLargeAction::Process;
+    }
+
+    [[nodiscard]] auto wants_file(const Path &relative_path) const noexcept -> bool override
+    {
+        return relative_path.extension() == extension_;
+    }
+
+    [[nodiscard]] auto transform_file(const ModFile file) noexcept
+        -> std::optional<std::vector<std::byte>> override
+    {
+        auto content = require_expected(*file.content);
+        content.push_back(std::byte(byte_));
+        return content;
+    }
+
+    [[nodiscard]] auto settings_hash() const noexcept -> std::optional<std::uint64_t> override
+    {
+        return static_cast<std::uint64_t>(byte_);
+    }
+    [[nodiscard]] auto id() const noexcept -> std::optional<std::u8string> override { return u8"append"; }
+
+private:
+    char byte_;
+    Path extension_;
+};
+
+/// Only reads the files, without changing them
+class ReadOnlyTransformer final : public btu::modmanager::ModFolderTransformer
+{
+public:
+    [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                         ArchiveTooLargeState /*state*/) noexcept
+        -> ArchiveTooLargeAction override
+    {
+        return ArchiveTooLargeAction::Skip;
+    }
+
+    [[nodiscard]] auto transform_file(const ModFile file) noexcept
+        -> std::optional<std::vector<std::byte>> override
+    {
+        seen.push_back(require_expected(file.content.view()).size());
+        return std::nullopt;
+    }
+
+    std::vector<size_t> seen;
+};
+
+/// Records the worker contexts it creates and receives
+class ContextTransformer final : public btu::modmanager::ModFolderTransformer
+{
+public:
+    [[nodiscard]] auto archive_too_large(const Path & /*archive_path*/,
+                                         ArchiveTooLargeState /*state*/) noexcept
+        -> ArchiveTooLargeAction override
+    {
+        return ArchiveTooLargeAction::Skip;
+    }
+
+    [[nodiscard]] auto make_worker_context() const noexcept
+        -> std::unique_ptr<btu::modmanager::WorkerContext> override
+    {
+        auto context = std::make_unique<btu::modmanager::WorkerContext>();
+        created.push_back(context.get());
+        return context;
+    }
+
+    [[nodiscard]] auto transform_file(const ModFile file) noexcept
+        -> std::optional<std::vector<std::byte>> override
+    {
+        received.push_back(file.worker_context);
+        return std::nullopt;
+    }
+
+    mutable std::vector<btu::modmanager::WorkerContext *> created;
+    std::vector<btu::modmanager::WorkerContext *> received;
+};
+
+[[nodiscard]] auto make_file(const Path &relative_path, const std::string &content) -> ModFile
+{
+    const auto bytes = std::as_bytes(std::span(content));
+    return ModFile{relative_path, FileContent::from_bytes({bytes.begin(), bytes.end()})};
+}
+
+[[nodiscard]] auto as_string(const std::vector<std::byte> &bytes) -> std::string
+{
+    return {reinterpret_cast<const char *>(bytes.data()), bytes.size()};
+}
+} // namespace
+
+TEST_CASE("TransformerChain", "[src]")
+{
+    auto nif_a     = AppendTransformer('a', ".nif");
+    auto read_only = ReadOnlyTransformer{};
+    auto nif_b     = AppendTransformer('b', ".nif");
+    auto dds_c     = AppendTransformer('c', ".dds");
+
+    auto chain = btu::modmanager::TransformerChain({nif_a, read_only, nif_b, dds_c});
+
+    SECTION("each transformer gets the output of the previous one")
+    {
+        const auto out = chain.transform_file(make_file("mesh.nif", "x"));
+        REQUIRE(out.has_value());
+        CHECK(as_string(*out) == "xab");
+        CHECK(read_only.seen == std::vector<size_t>{2});
+    }
+    SECTION("unwanted files are left to other transformers")
+    {
+        const auto out = chain.transform_file(make_file("texture.dds", "x"));
+        REQUIRE(out.has_value());
+        CHECK(as_string(*out) == "xc");
+
+        CHECK(chain.wants_file("texture.dds"));
+        CHECK_FALSE(btu::modmanager::TransformerChain({nif_a, dds_c}).wants_file("sound.wav"));
+    }
+    SECTION("files changed by no transformer are left unchanged")
+    {
+        CHECK_FALSE(chain.transform_file(make_file("sound.wav", "x")).has_value());
+        CHECK(read_only.seen == std::vector<size_t>{1});
+    }
+    SECTION("settings and id combine the transformers")
+    {
+        CHECK_FALSE(chain.id().has_value());
+
+        auto with_ids = btu::modmanager::TransformerChain({nif_a, dds_c});
+        CHECK(with_ids.id() == u8"append+append");
+        CHECK(with_ids.settings_hash() != btu::modmanager::TransformerChain({dds_c, nif_a}).settings_hash());
+    }
+    SECTION("each transformer gets its own worker context")
+    {
+        auto first  = ContextTransformer{};
+        auto second = ContextTransformer{};
+        auto with_contexts = btu::modmanager::TransformerChain({first, nif_a, second});
+
+        const auto context = with_contexts.make_worker_context();
+        for (int i = 0; i < 2; ++i)
+        {
+            auto file           = make_file("mesh.nif", "x");
+            file.worker_context = context.get();
+            CHECK(with_contexts.transform_file(std::move(file)).has_value());
+        }
+
+        REQUIRE(first.created.size() == 1);
+        REQUIRE(second.created.size() == 1);
+        CHECK(first.created[0] != second.created[0]);
+        CHECK(first.received == std::vector(2, first.created[0]));
+        CHECK(second.received == std::vector(2, second.created[0]));
+
+        // A context the chain did not create is not handed over
+        auto foreign        = btu::modmanager::WorkerContext{};
+        auto file           = make_file("mesh.nif", "x");
+        file.worker_context = &foreign;
+        CHECK(with_contexts.transform_file(std::move(file)).has_value());
+        CHECK(first.received.back() == nullptr);
+        CHECK(second.received.back() == nullptr);
+    }
+    SECTION("archives are skipped if any transformer skips them")
+    {
+        CHECK(chain.archive_too_large("a.bsa", ReadOnlyTransformer::ArchiveTooLargeState::BeforeProcessing)
+              == ReadOnlyTransformer::ArchiveTooLargeAction::Skip);
+    }
+}
@@ -0,0 +1,135 @@
+/* Copyright (C) 2024 G'k
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "./utils.hpp"
+
+#include <btu/tex/analysis.hpp>
+#include <btu/tex/functions.hpp>
+#include <btu/tex/optimize.hpp>
+
+using btu::tex::Texture;
+
+namespace {
+/// 8x8 texture, whose pixels are set by `pixel(x, y)`
+template<class Pixel>
+[[nodiscard]] auto generate(DXGI_FORMAT format, Pixel pixel) -> Texture
+{
+    auto image = btu::tex::ScratchImage{};
+    REQUIRE(SUCCEEDED(image.Initialize2D(format, 8, 8, 1, 1)));
+
+    const auto *img = image.GetImage(0, 0, 0);
+    for (size_t y = 0; y < img->height; ++y)
+    {
+        for (size_t x = 0; x < img->width; ++x)
+        {
+            const std::array<uint8_t, 4> value = pixel(x, y);
+            std::ranges::copy(value, img->pixels + y * img->rowPitch + x * 4); // NOLINT
+        }
+    }
+
+    auto tex = Texture{};
+    tex.set(std::move(image));
+    return tex;
+}
+} // namespace
+
+TEST_CASE("analyze", "[src]")
+{
+    SECTION("uniform gray texture")
+    {
+        const auto tex = generate(DXGI_FORMAT_R8G8B8A8_UNORM,
+                                  [](size_t, size_t) { return std::array<uint8_t, 4>{128, 128, 128, 255}; });
+        const auto res = btu::tex::analyze(tex);
+        REQUIRE(res.has_value());
+        CHECK(res->opaque_alpha());
+        CHECK(res->binary_alpha);
+        CHECK(res->grayscale);
+        CHECK(res->uniform());
+        CHECK(res->min == std::array<uint8_t, 4>{128, 128, 128, 255});
+    }
+    SECTION("colored texture with alpha")
+    {
+        const auto tex = generate(DXGI_FORMAT_R8G8B8A8_UNORM, [](size_t x, size_t y) {
+            const auto alpha = y == 0 ? uint8_t{0} : uint8_t{255};
+            return std::array<uint8_t, 4>{static_cast<uint8_t>(x * 30), 20, 40, alpha};
+        });
+        const auto res = btu::tex::analyze(tex);
+        REQUIRE(res.has_value());
+        CHECK_FALSE(res->opaque_alpha());
+        CHECK(res->binary_alpha);
+        CHECK_FALSE(res->grayscale);
+        CHECK_FALSE(res->uniform());
+        CHECK(res->min == std::array<uint8_t, 4>{0, 20, 40, 0});
+        CHECK(res->max == std::array<uint8_t, 4>{210, 20, 40, 255});
+    }
+    SECTION("BGRA channels are reordered, and X8 is opaque")
+    {
+        const auto pixel = [](size_t, size_t y) {
+            return std::array<uint8_t, 4>{10, 20, 30, static_cast<uint8_t>(y)};
+        };
+
+        const auto bgra = btu::tex::analyze(generate(DXGI_FORMAT_B8G8R8A8_UNORM, pixel));
+        REQUIRE(bgra.has_value());
+        CHECK(bgra->min == std::array<uint8_t, 4>{30, 20, 10, 0});
+        CHECK_FALSE(bgra->binary_alpha);
+
+        const auto bgrx = btu::tex::analyze(generate(DXGI_FORMAT_B8G8R8X8_UNORM, pixel));
+        REQUIRE(bgrx.has_value());
+        CHECK(bgrx->opaque_alpha());
+        CHECK(bgrx->binary_alpha);
+    }
+    SECTION("compressed textures are decoded")
+    {
+        const auto pixel = [](size_t x, size_t y) {
+            return std::array<uint8_t, 4>{static_cast<uint8_t>(x * 30), static_cast<uint8_t>(y * 30), 0, 255};
+        };
+        auto compressed = btu::tex::convert(generate(DXGI_FORMAT_R8G8B8A8_UNORM, pixel),
+                                            DXGI_FORMAT_BC3_UNORM,
+                                            compression_dev);
+        REQUIRE(compressed.has_value());
+        const auto res = btu::tex::analyze(*compressed);
+
+        const auto decompressed = btu::tex::decompress(std::move(*compressed));
+        REQUIRE(decompressed.has_value());
+        const auto expected = btu::tex::analyze(*decompressed);
+        REQUIRE(res.has_value());
+        REQUIRE(expected.has_value());
+        CHECK(res->min == expected->min);
+        CHECK(res->max == expected->max);
+        CHECK(res->binary_alpha == expected->binary_alpha);
+        CHECK(res->grayscale == expected->grayscale);
+    }
+    SECTION("opaque alpha matches DirectXTex on compressed textures")
+    {
+        for (const uint8_t alpha : {uint8_t{254}, uint8_t{250}})
+        {
+            const auto pixel = [alpha](size_t x, size_t) {
+                return std::array<uint8_t, 4>{static_cast<uint8_t>(x * 30), 20, 40, alpha};
+            };
+            const auto tex = btu::tex::convert(generate(DXGI_FORMAT_R8G8B8A8_UNORM, pixel),
+                                               DXGI_FORMAT_BC3_UNORM,
+                                               compression_dev);
+            REQUIRE(tex.has_value());
+
+            const auto res = btu::tex::analyze(*tex);
+            REQUIRE(res.has_value());
+            CHECK(res->opaque_alpha() == tex->get().IsAlphaAllOpaque());
+            CHECK(res->opaque_alpha() == (alpha == 254));
+        }
+    }
+    SECTION("the planner shares its analysis")
+    {
+        const auto &sets  = btu::tex::Settings::get(btu::Game::SSE);
+        const auto opaque = [](size_t, size_t) { return std::array<uint8_t, 4>{1, 2, 3, 255}; };
+
+        const auto with_alpha = generate(DXGI_FORMAT_R8G8B8A8_UNORM, opaque);
+        const auto steps      = btu::tex::compute_optimization_steps(with_alpha, sets);
+        REQUIRE(steps.analysis.has_value());
+        CHECK(steps.analysis->opaque_alpha());
+
+        const auto without_alpha = generate(DXGI_FORMAT_B8G8R8X8_UNORM, opaque);
+        CHECK_FALSE(btu::tex::compute_optimization_steps(without_alpha, sets).analysis.has_value());
+    }
+}
@@ -1,9 +1,16 @@
 #include "./utils.hpp"
 
 #include <btu/common/filesystem.hpp>
+#include <btu/tex/detail/decompress_bcn.hpp>
 #include <btu/tex/functions.hpp>
 
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <iterator>
+#include <random>
+#include <span>
+#include <thread>
 
 using btu::tex::Dimension, btu::tex::Texture;
 
@@ -71,6 +78,579 @@ TEST_CASE("convert", "[src]")
             return btu::tex::convert(std::forward<decltype(tex)>(tex), DXGI_FORMAT_BC1_UNORM, compression_dev);
         });
     }
+    SECTION("bc7 with mipmaps")
+    {
+        // Small mips are encoded concurrently, and must still end up in the right place
+        const auto to_rgba = [](Texture &&tex) {
+            return btu::tex::convert(std::move(tex), DXGI_FORMAT_R8G8B8A8_UNORM, compression_dev);
+        };
+        const auto to_bc7 = [](Texture &&tex) {
+            return btu::tex::convert(std::move(tex), DXGI_FORMAT_BC7_UNORM, compression_dev);
+        };
+        const auto reference = btu::tex::generate_mipmaps(load_tex(u8"convert_bc1/in/01.dds"))
+                                   .and_then(to_rgba);
+        const auto roundtrip = btu::tex::generate_mipmaps(load_tex(u8"convert_bc1/in/01.dds"))
+                                   .and_then(to_rgba)
+                                   .and_then(to_bc7)
+                                   .and_then(btu::tex::decompress);
+        REQUIRE(reference.has_value());
+        REQUIRE(roundtrip.has_value());
+        CHECK(compute_mse(*roundtrip, *reference) < 1e-3F);
+    }
+    SECTION("a stop request cancels the conversion")
+    {
+        auto source = std::stop_source{};
+        source.request_stop();
+
+        for (const auto format : {DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC1_UNORM})
+        {
+            auto tex       = load_tex(u8"convert_bc1/in/01.dds");
+            const auto res = btu::tex::convert(std::move(tex),
+                                               format,
+                                               compression_dev,
+                                               btu::tex::EncodingQuality::Normal,
+                                               btu::tex::BcEncoder::Builtin,
+                                               source.get_token());
+            REQUIRE_FALSE(res.has_value());
+            CHECK(res.error() == btu::tex::TextureErr::Cancelled);
+        }
+    }
+    SECTION("a stop requested during the conversion cancels it")
+    {
+        // Large enough for the stop to arrive long before the encoding is done
+        const auto generate = [] {
+            auto image = btu::tex::ScratchImage{};
+            REQUIRE(SUCCEEDED(image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, 4096, 4096, 1, 1)));
+            auto rng = std::mt19937{42}; // NOLINT(cert-msc32-c,cert-msc51-cpp)
+            const auto random = [&] { return static_cast<uint8_t>(rng()); };
+            std::generate_n(image.GetPixels(), image.GetPixelsSize(), random);
+
+            auto tex = Texture{};
+            tex.set(std::move(image));
+            return tex;
+        };
+
+        for (const auto format : {DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC1_UNORM})
+        {
+            auto tex     = generate();
+            auto source  = std::stop_source{};
+            auto stopper = std::jthread([&source] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                source.request_stop();
+            });
+            const auto res = btu::tex::convert(std::move(tex),
+                                               format,
+                                               compression_dev,
+                                               btu::tex::EncodingQuality::Max,
+                                               btu::tex::BcEncoder::Builtin,
+                                               source.get_token());
+            REQUIRE_FALSE(res.has_value());
+            CHECK(res.error() == btu::tex::TextureErr::Cancelled);
+        }
+    }
+    SECTION("every quality preset gives a usable texture")
+    {
+        using btu::tex::EncodingQuality;
+        const auto reference = btu::tex::convert(load_tex(u8"convert_bc1/in/01.dds"),
+                                                 DXGI_FORMAT_R8G8B8A8_UNORM,
+                                                 compression_dev);
+        REQUIRE(reference.has_value());
+
+        for (const auto format : {DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC1_UNORM})
+        {
+            for (const auto quality : {EncodingQuality::Fast, EncodingQuality::Normal, EncodingQuality::Max})
+            {
+                const auto roundtrip = btu::tex::convert(load_tex(u8"convert_bc1/in/01.dds"),
+                                                         format,
+                                                         compression_dev,
+                                                         quality)
+                                           .and_then(btu::tex::decompress);
+                REQUIRE(roundtrip.has_value());
+                CHECK(compute_mse(*roundtrip, *reference) < 1e-2F);
+            }
+        }
+
+        CHECK(btu::tex::compression_flags(DXGI_FORMAT_BC1_UNORM, EncodingQuality::Fast)
+              == btu::tex::compression_flags(DXGI_FORMAT_BC1_UNORM, EncodingQuality::Normal));
+        CHECK((btu::tex::compression_flags(DXGI_FORMAT_BC7_UNORM, EncodingQuality::Fast)
+                   & DirectX::TEX_COMPRESS_BC7_QUICK)
+              != 0);
+        CHECK((btu::tex::compression_flags(DXGI_FORMAT_BC1_UNORM, EncodingQuality::Max)
+               & DirectX::TEX_COMPRESS_DITHER)
+              != 0);
+    }
+}
+
+TEST_CASE("builtin bc encoder", "[src]")
+{
+    using btu::tex::BcEncoder;
+    using btu::tex::EncodingQuality;
+
+    const auto make_texture = [](size_t size, auto &&pixel) {
+        auto image = btu::tex::ScratchImage{};
+        REQUIRE(SUCCEEDED(image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1)));
+        const auto pixels = std::span(image.GetPixels(), image.GetPixelsSize());
+        for (size_t i = 0; i < pixels.size(); ++i)
+            pixels[i] = pixel(i / 4 % size, i / 4 / size, i % 4);
+
+        auto tex = Texture{};
+        tex.set(std::move(image));
+        return tex;
+    };
+
+    SECTION("quality is close to DirectXTex")
+    {
+        // Uncompressed, so that the encoders are not judged on the artifacts of a previous compression
+        const auto generate = [&](bool noise) {
+            auto rng = std::mt19937{42}; // NOLINT(cert-msc32-c,cert-msc51-cpp)
+            return make_texture(256, [&](size_t x, size_t y, size_t channel) {
+                const auto smooth = std::array{x, y, (x + y) / 2, 255 - x}[channel];
+                return static_cast<uint8_t>(noise ? rng() : smooth);
+            });
+        };
+
+        // BC4 and BC5 decompress to fewer channels, so the source is converted to the same format
+        const auto mse = [&](bool noise, DXGI_FORMAT format, EncodingQuality quality, BcEncoder encoder) {
+            const auto roundtrip
+                = btu::tex::convert(generate(noise), format, compression_dev, quality, encoder)
+                      .and_then(btu::tex::decompress);
+            REQUIRE(roundtrip.has_value());
+
+            const auto decoded_format = roundtrip->get().GetMetadata().format;
+            const auto to_decoded     = [&](Texture &&tex) {
+                return btu::tex::convert(std::move(tex), decoded_format, compression_dev);
+            };
+            const auto source         = decoded_format == DXGI_FORMAT_R8G8B8A8_UNORM
+                                            ? btu::tex::Result(generate(noise))
+                                            : to_decoded(generate(noise));
+            REQUIRE(source.has_value());
+            return compute_mse(*roundtrip, *source);
+        };
+
+        for (const bool noise : {false, true})
+        {
+            for (const auto format :
+                 {DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC4_UNORM, DXGI_FORMAT_BC5_UNORM})
+            {
+                const auto reference = mse(noise, format, EncodingQuality::Normal, BcEncoder::DirectXTex);
+                const auto fast      = mse(noise, format, EncodingQuality::Fast, BcEncoder::Builtin);
+                const auto normal    = mse(noise, format, EncodingQuality::Normal, BcEncoder::Builtin);
+                const auto max       = mse(noise, format, EncodingQuality::Max, BcEncoder::Builtin);
+                INFO("noise: " << noise << ", format: " << format << ", DirectXTex MSE: " << reference);
+                INFO("builtin MSE: fast " << fast << ", normal " << normal << ", max " << max);
+
+                CHECK(max <= normal);
+                CHECK(normal <= fast);
+                CHECK(normal <= reference * 1.15F + 1e-5F);
+                CHECK(fast <= reference * 1.5F + 1e-5F);
+            }
+        }
+    }
+
+    // Blocks whose colors are exactly representable have a single best encoding
+    const auto encode_block = [&](const std::array<std::array<uint8_t, 4>, 16> &block,
+                                  DXGI_FORMAT format,
+                                  EncodingQuality quality) {
+        auto encoded = btu::tex::convert(make_texture(4, [&](size_t x, size_t y, size_t channel) {
+                                             return block[y * 4 + x][channel];
+                                         }),
+                                         format,
+                                         compression_dev,
+                                         quality,
+                                         BcEncoder::Builtin);
+        REQUIRE(encoded.has_value());
+        const auto &image = encoded->get();
+        const auto bytes  = std::vector(image.GetPixels(), image.GetPixels() + image.GetPixelsSize());
+
+        // The palette is checked by decoding the block back
+        const auto decoded = btu::tex::decompress(std::move(*encoded));
+        REQUIRE(decoded.has_value());
+        const auto &decoded_image = *decoded->get().GetImage(0, 0, 0);
+        const auto channels       = DirectX::BitsPerPixel(decoded_image.format) / 8;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const auto *pixel = decoded_image.pixels + (i / 4) * decoded_image.rowPitch + (i % 4) * channels;
+            for (size_t channel = 0; channel < channels; ++channel)
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                CHECK(pixel[channel] == block[i][channel]);
+        }
+        return bytes;
+    };
+    const auto little_endian = [](uint64_t value, size_t count) {
+        auto bytes = std::vector<uint8_t>{};
+        for (size_t i = 0; i < count; ++i)
+            bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        return bytes;
+    };
+
+    constexpr auto red         = std::array<uint8_t, 4>{255, 0, 0, 255};
+    constexpr auto cyan        = std::array<uint8_t, 4>{0, 255, 255, 255};
+    constexpr auto transparent = std::array<uint8_t, 4>{0, 0, 0, 0};
+    // 0xF800 and 0x07FF in RGB565
+    const auto red_565  = std::vector<uint8_t>{0x00, 0xF8};
+    const auto cyan_565 = std::vector<uint8_t>{0xFF, 0x07};
+
+    SECTION("bc4 block using the whole 8 values palette")
+    {
+        constexpr auto palette = std::array<uint8_t, 8>{210, 70, 190, 170, 150, 130, 110, 90};
+        auto block             = std::array<std::array<uint8_t, 4>, 16>{};
+        auto indices           = uint64_t{0};
+        for (size_t i = 0; i < block.size(); ++i)
+        {
+            block[i] = {palette[i % 8], 0, 0, 255};
+            indices |= uint64_t{i % 8} << (3 * i);
+        }
+
+        auto expected = std::vector<uint8_t>{210, 70};
+        std::ranges::copy(little_endian(indices, 6), std::back_inserter(expected));
+        for (const auto quality : {EncodingQuality::Fast, EncodingQuality::Normal, EncodingQuality::Max})
+            CHECK(encode_block(block, DXGI_FORMAT_BC4_UNORM, quality) == expected);
+    }
+
+    // `Fast` insets the endpoints of the bounding box, so it does not find the exact ones
+    SECTION("bc1 block using the four colors palette")
+    {
+        constexpr auto colors = std::array<std::array<uint8_t, 4>, 4>{
+            red,
+            cyan,
+            std::array<uint8_t, 4>{170, 85, 85, 255},
+            std::array<uint8_t, 4>{85, 170, 170, 255},
+        };
+        auto block   = std::array<std::array<uint8_t, 4>, 16>{};
+        auto indices = uint64_t{0};
+        for (size_t i = 0; i < block.size(); ++i)
+        {
+            block[i] = colors[i % 4];
+            indices |= uint64_t{i % 4} << (2 * i);
+        }
+
+        // The four colors mode needs the first endpoint to be greater
+        auto expected = red_565;
+        std::ranges::copy(cyan_565, std::back_inserter(expected));
+        std::ranges::copy(little_endian(indices, 4), std::back_inserter(expected));
+        for (const auto quality : {EncodingQuality::Normal, EncodingQuality::Max})
+            CHECK(encode_block(block, DXGI_FORMAT_BC1_UNORM, quality) == expected);
+    }
+    SECTION("bc1 block with transparent pixels")
+    {
+        constexpr auto colors        = std::array{red, cyan, transparent};
+        constexpr auto color_indices = std::array<uint64_t, 3>{1, 0, 3};
+        auto block                   = std::array<std::array<uint8_t, 4>, 16>{};
+        auto indices                 = uint64_t{0};
+        for (size_t i = 0; i < block.size(); ++i)
+        {
+            block[i] = colors[i % 3];
+            indices |= color_indices[i % 3] << (2 * i);
+        }
+
+        // The three colors mode needs the first endpoint to be smaller, and index 3 is transparent
+        auto expected = cyan_565;
+        std::ranges::copy(red_565, std::back_inserter(expected));
+        std::ranges::copy(little_endian(indices, 4), std::back_inserter(expected));
+        for (const auto quality : {EncodingQuality::Normal, EncodingQuality::Max})
+            CHECK(encode_block(block, DXGI_FORMAT_BC1_UNORM, quality) == expected);
+    }
+}
+
+TEST_CASE("native bc decoder", "[src]")
+{
+    SECTION("encoded textures")
+    {
+        for (const auto format : {DXGI_FORMAT_BC1_UNORM,
+                                  DXGI_FORMAT_BC2_UNORM,
+                                  DXGI_FORMAT_BC3_UNORM,
+                                  DXGI_FORMAT_BC4_UNORM,
+                                  DXGI_FORMAT_BC5_UNORM,
+                                  DXGI_FORMAT_BC7_UNORM})
+        {
+            INFO("format: " << format);
+            auto compressed = btu::tex::convert(load_tex(u8"convert_bc1/in/01.dds"), format, compression_dev);
+            REQUIRE(compressed.has_value());
+
+            const auto &tex = compressed->get();
+            auto reference  = btu::tex::ScratchImage{};
+            REQUIRE(SUCCEEDED(DirectX::Decompress(tex.GetImages(),
+                                                  tex.GetImageCount(),
+                                                  tex.GetMetadata(),
+                                                  DXGI_FORMAT_UNKNOWN,
+                                                  reference)));
+            auto expected = Texture{};
+            expected.set(std::move(reference));
+
+            const auto decoded = btu::tex::decompress(std::move(*compressed));
+            REQUIRE(decoded.has_value());
+            CHECK(decoded->get().GetMetadata() == expected.get().GetMetadata());
+            CHECK(compute_mse(*decoded, expected) == 0.F);
+        }
+    }
+
+    // Encoders never use some modes, so blocks are written by hand to cover every one of them
+    const auto check_blocks = [](DXGI_FORMAT format, const std::vector<uint8_t> &blocks) {
+        INFO("format: " << format);
+        const auto block_size = DirectX::BitsPerPixel(format) * 2;
+        auto image            = btu::tex::ScratchImage{};
+        REQUIRE(SUCCEEDED(image.Initialize2D(format, blocks.size() / block_size * 4, 4, 1, 1)));
+        REQUIRE(image.GetPixelsSize() == blocks.size());
+        std::ranges::copy(blocks, image.GetPixels());
+
+        auto reference = btu::tex::ScratchImage{};
+        REQUIRE(SUCCEEDED(DirectX::Decompress(*image.GetImage(0, 0, 0), DXGI_FORMAT_UNKNOWN, reference)));
+
+        auto tex = Texture{};
+        tex.set(std::move(image));
+        const auto decoded = btu::tex::decompress(std::move(tex));
+        REQUIRE(decoded.has_value());
+        REQUIRE(decoded->get().GetMetadata() == reference.GetMetadata());
+
+        const auto &decoded_image   = *decoded->get().GetImage(0, 0, 0);
+        const auto &reference_image = *reference.GetImage(0, 0, 0);
+        const auto actual           = std::span(decoded_image.pixels, decoded_image.slicePitch);
+        const auto expected         = std::span(reference_image.pixels, reference_image.slicePitch);
+        const auto mismatch         = std::ranges::mismatch(actual, expected);
+        const auto offset           = static_cast<size_t>(mismatch.in1 - actual.begin());
+        const auto pixel_size       = DirectX::BitsPerPixel(reference_image.format) / 8;
+        INFO("first difference in block " << offset % reference_image.rowPitch / pixel_size / 4);
+        CHECK(mismatch.in1 == actual.end());
+    };
+
+    auto rng          = std::mt19937{42}; // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    const auto random = [&](size_t size) {
+        auto bytes = std::vector<uint8_t>(size);
+        std::ranges::generate(bytes, [&] { return static_cast<uint8_t>(rng()); });
+        return bytes;
+    };
+    const auto append = [](std::vector<uint8_t> &blocks, const std::vector<uint8_t> &block) {
+        blocks.insert(blocks.end(), block.begin(), block.end());
+    };
+
+    // Modes are chosen by the order of the endpoints: 0 puts the greater one first, 1 the smaller one, and 2
+    // makes them equal
+    const auto order = [](auto &first, auto &second, size_t mode) {
+        if (mode == 2)
+        {
+            second = first;
+            return;
+        }
+        if (first == second)
+            second ^= 1U;
+        if ((mode == 0) != (first > second))
+            std::swap(first, second);
+    };
+    // BC4 blocks, also used for the alpha of BC3 and the channels of BC5: 8 values, 6 values with 0 and 255
+    const auto single_block = [&](size_t mode) {
+        auto block = random(8);
+        order(block[0], block[1], mode);
+        return block;
+    };
+    // BC1 blocks, also used for the colors of BC2 and BC3: 4 colors, 3 colors with transparent black
+    const auto color_block = [&](size_t mode) {
+        auto block = random(8);
+        auto c0    = static_cast<uint16_t>(block[0] | block[1] << 8);
+        auto c1    = static_cast<uint16_t>(block[2] | block[3] << 8);
+        order(c0, c1, mode);
+        block[0] = static_cast<uint8_t>(c0);
+        block[1] = static_cast<uint8_t>(c0 >> 8);
+        block[2] = static_cast<uint8_t>(c1);
+        block[3] = static_cast<uint8_t>(c1 >> 8);
+        return block;
+    };
+
+    constexpr size_t k_blocks_per_mode = 64;
+
+    SECTION("bc1 to bc5")
+    {
+        auto bc1 = std::vector<uint8_t>{};
+        auto bc2 = std::vector<uint8_t>{};
+        auto bc3 = std::vector<uint8_t>{};
+        auto bc4 = std::vector<uint8_t>{};
+        auto bc5 = std::vector<uint8_t>{};
+        for (size_t i = 0; i < 3 * k_blocks_per_mode; ++i)
+        {
+            append(bc1, color_block(i % 3));
+            // BC2 and BC3 always decode colors with 4 values, whatever the order of the endpoints
+            append(bc2, random(8));
+            append(bc2, color_block(i % 3));
+            append(bc3, single_block(i % 3));
+            append(bc3, color_block(i / 3 % 3));
+            append(bc4, single_block(i % 3));
+            append(bc5, single_block(i % 3));
+            append(bc5, single_block(i / 3 % 3));
+        }
+
+        check_blocks(DXGI_FORMAT_BC1_UNORM, bc1);
+        check_blocks(DXGI_FORMAT_BC2_UNORM, bc2);
+        check_blocks(DXGI_FORMAT_BC3_UNORM, bc3);
+        check_blocks(DXGI_FORMAT_BC4_UNORM, bc4);
+        check_blocks(DXGI_FORMAT_BC5_UNORM, bc5);
+    }
+    SECTION("every instruction set gives the same pixels")
+    {
+        using btu::tex::detail::InstructionSet;
+
+        // BC1 covers the colors kernel, BC3 and BC5 the single channel one on alpha, red and green.
+        // Instruction sets the CPU lacks fall back to the scalar kernels.
+        for (const auto format : {DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC5_UNORM})
+        {
+            INFO("format: " << format);
+            auto blocks = std::vector<uint8_t>{};
+            for (size_t i = 0; i < 3 * k_blocks_per_mode; ++i)
+            {
+                if (format != DXGI_FORMAT_BC1_UNORM)
+                    append(blocks, single_block(i % 3));
+                const auto mode = i / 3 % 3;
+                append(blocks, format == DXGI_FORMAT_BC5_UNORM ? single_block(mode) : color_block(mode));
+            }
+
+            const auto width  = blocks.size() / (DirectX::BitsPerPixel(format) * 2) * 4;
+            const auto source = DirectX::Image{
+                .width      = width,
+                .height     = 4,
+                .format     = format,
+                .rowPitch   = blocks.size(),
+                .slicePitch = blocks.size(),
+                .pixels     = blocks.data(),
+            };
+            const auto decode = [&](InstructionSet isa) {
+                auto pixels       = std::vector<uint8_t>(width * 4 * 4);
+                const auto target = DirectX::Image{
+                    .width      = width,
+                    .height     = 4,
+                    .format     = DXGI_FORMAT_R8G8B8A8_UNORM,
+                    .rowPitch   = width * 4,
+                    .slicePitch = pixels.size(),
+                    .pixels     = pixels.data(),
+                };
+                btu::tex::detail::decompress_bcn({&source, 1}, {&target, 1}, isa);
+                return pixels;
+            };
+
+            const auto scalar = decode(InstructionSet::Scalar);
+            CHECK(decode(InstructionSet::Sse41) == scalar);
+            CHECK(decode(InstructionSet::Avx2) == scalar);
+        }
+    }
+    SECTION("bc7")
+    {
+        // Fields are stored from the least significant bit of the first byte
+        const auto set_bits = [](std::vector<uint8_t> &block, size_t offset, size_t count, size_t value) {
+            for (size_t bit = 0; bit < count; ++bit)
+            {
+                const auto mask = static_cast<uint8_t>(1U << ((offset + bit) % 8));
+                auto &byte      = block[(offset + bit) / 8];
+                byte            = ((value >> bit) & 1U) != 0 ? byte | mask : byte & ~mask;
+            }
+        };
+
+        struct ModeFields
+        {
+            size_t partition_bits;
+            size_t rotation_bits;
+            size_t index_selection_bits;
+        };
+        // Modes 0 and 2 have three subsets, 1, 3 and 7 have two
+        constexpr auto k_modes = std::array<ModeFields, 8>{{
+            {4, 0, 0},
+            {6, 0, 0},
+            {6, 0, 0},
+            {6, 0, 0},
+            {0, 2, 1},
+            {0, 2, 0},
+            {0, 0, 0},
+            {6, 0, 0},
+        }};
+
+        auto bc7 = std::vector<uint8_t>{};
+        for (size_t mode = 0; mode < k_modes.size(); ++mode)
+        {
+            const auto &fields = k_modes[mode];
+            for (size_t i = 0; i < k_blocks_per_mode; ++i)
+            {
+                // The mode is the number of zero bits before the first set one. Endpoints, p-bits and indices
+                // are random, every value is valid.
+                auto block = random(16);
+                set_bits(block, 0, mode + 1, size_t{1} << mode);
+
+                // Every partition, with their anchors, and every rotation and index selection
+                auto offset = mode + 1;
+                set_bits(block, offset, fields.partition_bits, i);
+                offset += fields.partition_bits;
+                set_bits(block, offset, fields.rotation_bits, i);
+                offset += fields.rotation_bits;
+                set_bits(block, offset, fields.index_selection_bits, i >> fields.rotation_bits);
+                append(bc7, block);
+            }
+        }
+
+        // Reserved mode
+        auto reserved = random(16);
+        reserved[0]   = 0;
+        append(bc7, reserved);
+
+        check_blocks(DXGI_FORMAT_BC7_UNORM, bc7);
+    }
+}
+
+TEST_CASE("transcode", "[src]")
+{
+    // Random blocks, edited by `fix` to meet the requirements of the transcoding
+    const auto generate = [](DXGI_FORMAT format, auto fix) {
+        auto image = btu::tex::ScratchImage{};
+        REQUIRE(SUCCEEDED(image.Initialize2D(format, 64, 64, 1, 1)));
+
+        auto rng              = std::mt19937{42}; // NOLINT(cert-msc32-c,cert-msc51-cpp)
+        const auto block_size = DirectX::BitsPerPixel(format) * 2;
+        for (size_t i = 0; i < image.GetPixelsSize(); i += block_size)
+        {
+            auto *block = image.GetPixels() + i; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            std::generate_n(block, block_size, [&] { return static_cast<uint8_t>(rng()); });
+            fix(std::span(block, block_size));
+        }
+
+        auto tex = Texture{};
+        tex.set(std::move(image));
+        return tex;
+    };
+    const auto decoded_mse = [](Texture &&lhs, Texture &&rhs) {
+        const auto lhs_decoded = btu::tex::decompress(std::move(lhs));
+        const auto rhs_decoded = btu::tex::decompress(std::move(rhs));
+        REQUIRE(lhs_decoded.has_value());
+        REQUIRE(rhs_decoded.has_value());
+        return compute_mse(*lhs_decoded, *rhs_decoded);
+    };
+
+    SECTION("BC3 with opaque alpha to BC1 is lossless")
+    {
+        const auto opaque = [](std::span<uint8_t> block) {
+            std::fill_n(block.begin(), 2, uint8_t{255});
+            std::fill_n(block.begin() + 2, 6, uint8_t{0});
+        };
+        REQUIRE(btu::tex::can_transcode(generate(DXGI_FORMAT_BC3_UNORM, opaque), DXGI_FORMAT_BC1_UNORM));
+        CHECK_FALSE(
+            btu::tex::can_transcode(generate(DXGI_FORMAT_BC3_UNORM, [](auto) {}), DXGI_FORMAT_BC1_UNORM));
+
+        auto source     = generate(DXGI_FORMAT_BC3_UNORM, opaque);
+        auto transcoded = btu::tex::transcode(std::move(source), DXGI_FORMAT_BC1_UNORM);
+        REQUIRE(transcoded.has_value());
+        CHECK(transcoded->get().GetMetadata().format == DXGI_FORMAT_BC1_UNORM);
+        CHECK(decoded_mse(std::move(*transcoded), generate(DXGI_FORMAT_BC3_UNORM, opaque)) == 0.F);
+    }
+    SECTION("BC1 to BC7 is close")
+    {
+        // Ordered endpoints select the four colors mode
+        const auto four_colors = [](std::span<uint8_t> block) {
+            block[1] |= 0x80;
+            block[3] &= 0x7F;
+        };
+        const auto source = [&] { return generate(DXGI_FORMAT_BC1_UNORM, four_colors); };
+        REQUIRE(btu::tex::can_transcode(source(), DXGI_FORMAT_BC7_UNORM));
+        CHECK_FALSE(btu::tex::can_transcode(source(), DXGI_FORMAT_BC3_UNORM));
+
+        auto transcoded = btu::tex::transcode(source(), DXGI_FORMAT_BC7_UNORM);
+        REQUIRE(transcoded.has_value());
+        CHECK(transcoded->get().GetMetadata().format == DXGI_FORMAT_BC7_UNORM);
+        CHECK(decoded_mse(std::move(*transcoded), source()) < 1e-4F);
+    }
 }
 
 TEST_CASE("generate_mipmaps", "[src]")
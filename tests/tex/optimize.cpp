@@ -277,6 +277,107 @@ TEST_CASE("compute_optimization_steps", "[src]")
         CHECK(res.best_format == sets.output_format.compressed);
         CHECK_FALSE(res.convert);
     }
+    SECTION("encoder settings are forwarded")
+    {
+        auto tex        = generate_tex(r8g8b8a8_512_no_mips_meta);
+        auto sets       = compress_whitelist_mips_resize_sets;
+        sets.quality    = btu::tex::EncodingQuality::Fast;
+        sets.bc_encoder = btu::tex::BcEncoder::Builtin;
+
+        const auto res = compute_optimization_steps(tex, sets);
+        CHECK(res.quality == btu::tex::EncodingQuality::Fast);
+        CHECK(res.bc_encoder == btu::tex::BcEncoder::Builtin);
+
+        const auto parsed = nlohmann::json(sets).get<btu::tex::Settings>();
+        CHECK(parsed.quality == btu::tex::EncodingQuality::Fast);
+        CHECK(parsed.bc_encoder == btu::tex::BcEncoder::Builtin);
+        CHECK(nlohmann::json(btu::tex::EncodingQuality::Max) == "max");
+    }
+    SECTION("settings saved without encoder keys use the defaults")
+    {
+        auto json = nlohmann::json(compress_whitelist_mips_resize_sets);
+        json.erase("quality");
+        json.erase("bc_encoder");
+
+        const auto parsed = json.get<btu::tex::Settings>();
+        CHECK(parsed.quality == btu::tex::EncodingQuality::Normal);
+        CHECK(parsed.bc_encoder == btu::tex::BcEncoder::DirectXTex);
+        CHECK(parsed.game == compress_whitelist_mips_resize_sets.game);
+        CHECK(parsed.allowed_formats == compress_whitelist_mips_resize_sets.allowed_formats);
+    }
+}
+
+TEST_CASE("inspect", "[src]")
+{
+    const auto inspect_saved = [](const btu::tex::Texture &tex, const btu::tex::Settings &sets) {
+        const auto data = btu::tex::save(tex);
+        REQUIRE(data.has_value());
+        const auto res = btu::tex::inspect(tex.get_load_path(), *data, sets);
+        REQUIRE(res.has_value());
+        return *res;
+    };
+    // The analysis can only come from the pixels
+    const auto steps_without_analysis = [](const btu::tex::Texture &tex, const btu::tex::Settings &sets) {
+        auto res = compute_optimization_steps(tex, sets);
+        res.analysis.reset();
+        return res;
+    };
+
+    SECTION("header is read")
+    {
+        auto meta      = bc7_512_no_mips_meta;
+        meta.mipLevels = 4;
+        meta.arraySize = 6;
+        meta.miscFlags = DirectX::TEX_MISC_TEXTURECUBE;
+        auto tex       = generate_tex(meta);
+
+        const auto res = inspect_saved(tex, compress_whitelist_mips_resize_sets);
+        CHECK(res.dimension == btu::tex::Dimension{512, 512});
+        CHECK(res.format == DXGI_FORMAT_BC7_UNORM);
+        CHECK(res.mip_count == 4);
+        CHECK(res.cubemap);
+        CHECK(res.needs_work());
+    }
+    SECTION("texture without alpha is decided by its header")
+    {
+        auto tex = generate_tex(bc5_512_no_mips_meta);
+        tex.set_load_path(u8"textures/file.dds");
+        auto sets     = landscape_sets;
+        sets.compress = true;
+
+        const auto res = inspect_saved(tex, sets);
+        CHECK_FALSE(res.needs_pixels);
+        CHECK(res.steps == steps_without_analysis(tex, sets));
+        CHECK_FALSE(res.needs_work());
+    }
+    SECTION("landscape texture without alpha is decided by its header")
+    {
+        auto tex = generate_landscape_tex(bc5_512_no_mips_meta);
+
+        const auto res = inspect_saved(tex, landscape_sets);
+        CHECK_FALSE(res.needs_pixels);
+        CHECK(res.steps == steps_without_analysis(tex, landscape_sets));
+        CHECK(res.needs_work());
+    }
+    SECTION("alpha decides the output format")
+    {
+        const auto sets = no_explicit_sets;
+
+        auto transparent = generate_tex(r8g8b8a8_512_no_mips_meta);
+        const auto res   = inspect_saved(transparent, sets);
+        CHECK(res.needs_pixels);
+        CHECK(res.needs_work());
+        CHECK(res.steps == steps_without_analysis(transparent, sets));
+
+        auto opaque = generate_opaque_tex(r8g8b8a8_512_no_mips_meta);
+        CHECK(inspect_saved(opaque, sets).needs_pixels);
+        const auto steps = compute_optimization_steps(opaque, sets);
+        CHECK(steps.best_format == sets.output_format.uncompressed_without_alpha);
+    }
+    SECTION("missing file")
+    {
+        CHECK_FALSE(btu::tex::inspect(u8"missing.dds", no_explicit_sets).has_value());
+    }
 }
 
 TEST_CASE("tex_optimize", "[src]")
@@ -371,6 +472,33 @@ TEST_CASE("tex_optimize", "[src]")
         CHECK(res_info.format == sets.output_format.compressed);
         CHECK(res_info.dimension == DirectX::TEX_DIMENSION_TEXTURE2D);
     }
+    SECTION("resize compressed with a full mip chain drops the top mips")
+    {
+        auto meta      = bc7_512_no_mips_meta;
+        meta.mipLevels = 10;
+        auto tex       = generate_tex(meta);
+
+        // Blocks are kept as is, so the 128x128 mip can be recognized
+        const auto *source_mip = tex.get().GetImage(2, 0, 0);
+        auto expected          = std::vector<uint8_t>(source_mip->slicePitch);
+        for (size_t i = 0; i < expected.size(); ++i)
+            expected[i] = static_cast<uint8_t>(i * 7);
+        std::ranges::copy(expected, source_mip->pixels);
+
+        auto steps = compute_optimization_steps(tex, resize_sets);
+        CHECK(steps.mipmaps);
+        auto res = optimize(std::move(tex), steps, compression_dev);
+        REQUIRE(res.has_value());
+
+        const auto res_info = res->get().GetMetadata();
+        CHECK(res_info.width == 128);
+        CHECK(res_info.height == 128);
+        CHECK(res_info.mipLevels == 8);
+        CHECK(res_info.format == resize_sets.output_format.compressed);
+
+        const auto *top = res->get().GetImage(0, 0, 0);
+        CHECK(std::equal(expected.begin(), expected.end(), top->pixels)); // NOLINT
+    }
     SECTION("resize uncompressed without alpha")
     {
         auto sets  = resize_sets;
@@ -459,6 +587,20 @@ TEST_CASE("tex_optimize", "[src]")
         CHECK_FALSE(res.has_value());
         CHECK(res.error() == btu::tex::TextureErr::BadInput);
     }
+    SECTION("the analysis of another texture is not trusted")
+    {
+        const auto steps = compute_optimization_steps(generate_opaque_tex(r8g8b8a8_512_no_mips_meta),
+                                                      no_explicit_sets);
+        REQUIRE(steps.analysis.has_value());
+        REQUIRE_FALSE(DirectX::HasAlpha(steps.best_format));
+
+        auto meta        = r8g8b8a8_512_no_mips_meta;
+        meta.width       = 256;
+        auto transparent = generate_tex(meta);
+        const auto res   = optimize(std::move(transparent), steps, compression_dev);
+        CHECK_FALSE(res.has_value());
+        CHECK(res.error() == btu::tex::TextureErr::BadInput);
+    }
     SECTION("expected_dir")
     {
         auto sets = compress_whitelist_mips_resize_sets;
@@ -473,3 +615,105 @@ TEST_CASE("tex_optimize", "[src]")
         });
     }
 }
+
+[[nodiscard]] static auto generate_gradient_tex(const DirectX::TexMetadata &meta) -> btu::tex::Texture
+{
+    auto tex = generate_tex(meta);
+
+    const auto height    = static_cast<float>(meta.height);
+    const auto transform = [&](DirectX::XMVECTOR *out_pixels,
+                               const DirectX::XMVECTOR *,
+                               const size_t width,
+                               const size_t y) {
+        for (size_t x = 0; x < width; ++x)
+        {
+            const auto u = static_cast<float>(x) / static_cast<float>(width);
+            const auto v = static_cast<float>(y) / height;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            out_pixels[x] = DirectX::XMVectorSet(u, v, 0.5F, 1.F - u);
+        }
+    };
+
+    DirectX::ScratchImage timage;
+    const auto &image = tex.get();
+    const auto hr = TransformImage(image.GetImages(), image.GetImageCount(), meta, transform, timage);
+    REQUIRE(SUCCEEDED(hr));
+    tex.set(std::move(timage));
+    return tex;
+}
+
+TEST_CASE("tex_optimize_fused", "[src]")
+{
+    const auto check_same_as_optimize = [](auto generate, const btu::tex::Settings &sets) {
+        auto tex         = generate();
+        const auto steps = compute_optimization_steps(tex, sets);
+        REQUIRE(btu::tex::can_optimize_fused(tex, steps, compression_dev));
+
+        const auto fused = btu::tex::optimize_fused(std::move(tex), steps, compression_dev);
+        REQUIRE(fused.has_value());
+        const auto expected = optimize(generate(), steps, compression_dev);
+        REQUIRE(expected.has_value());
+
+        // Filters are not the same, but should give very close results
+        CHECK(compute_mse(*fused, *expected) < 1e-4F);
+        return fused->get().IsAlphaAllOpaque();
+    };
+
+    SECTION("resize and mipmaps")
+    {
+        auto sets    = resize_sets;
+        sets.mipmaps = true;
+        const auto generate = [] { return generate_gradient_tex(r8g8b8a8_512_no_mips_meta); };
+        CHECK_FALSE(check_same_as_optimize(generate, sets));
+    }
+    SECTION("compressed input and output")
+    {
+        auto sets                                   = compress_whitelist_mips_resize_sets;
+        sets.output_format.compressed               = DXGI_FORMAT_BC3_UNORM;
+        sets.output_format.compressed_without_alpha = DXGI_FORMAT_BC1_UNORM;
+        check_same_as_optimize([] { return generate_tex(bc7_512_no_mips_meta); }, sets);
+    }
+    SECTION("bc7 output")
+    {
+        // The GPU encoder works on whole images, so the fused path is only taken without it
+        if (!compression_dev.list_adapters().empty())
+            return;
+
+        const auto generate = [] { return generate_gradient_tex(r8g8b8a8_512_no_mips_meta); };
+        REQUIRE(compute_optimization_steps(generate(), compress_whitelist_mips_resize_sets).best_format
+                == DXGI_FORMAT_BC7_UNORM);
+        CHECK_FALSE(check_same_as_optimize(generate, compress_whitelist_mips_resize_sets));
+    }
+    SECTION("landscape texture")
+    {
+        CHECK_FALSE(check_same_as_optimize([] { return generate_landscape_tex(r8g8b8a8_512_no_mips_meta); },
+                                           landscape_sets));
+    }
+    SECTION("unsupported textures fall back to optimize")
+    {
+        auto meta      = r8g8b8a8_512_no_mips_meta;
+        meta.arraySize = 2;
+
+        auto tex         = generate_tex(meta);
+        const auto steps = compute_optimization_steps(tex, mipmaps_sets);
+        CHECK_FALSE(btu::tex::can_optimize_fused(tex, steps, compression_dev));
+
+        const auto fused    = btu::tex::optimize_fused(std::move(tex), steps, compression_dev);
+        const auto expected = optimize(generate_tex(meta), steps, compression_dev);
+        REQUIRE(fused.has_value());
+        REQUIRE(expected.has_value());
+        CHECK(fused->get().GetMetadata() == expected->get().GetMetadata());
+    }
+    SECTION("a stop request cancels the optimization")
+    {
+        auto source = std::stop_source{};
+        source.request_stop();
+
+        auto tex         = generate_tex(r8g8b8a8_512_no_mips_meta);
+        const auto steps = compute_optimization_steps(tex, mipmaps_sets);
+        const auto token = source.get_token();
+        const auto res   = btu::tex::optimize_fused(std::move(tex), steps, compression_dev, token);
+        REQUIRE_FALSE(res.has_value());
+        CHECK(res.error() == btu::tex::TextureErr::Cancelled);
+    }
+}